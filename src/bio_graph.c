@@ -1,5 +1,6 @@
 // bio_graph.c Wen, Chifeng - Sept. 26, 2015
 #include "common.h"
+#include "parallel.h"
 #include "bio_graph.h"
 
 
@@ -17,32 +18,359 @@ struct bio_graph_vertex {
 };
 
 
+// list nodes are carved out of large blocks in allocation order and released all at once
+struct bio_graph_arena_block {
+        struct bio_graph_arena_block*  next;
+        int                            num_used;
+        int                            capacity;
+        struct bio_graph_list          nodes[];
+};
+
+struct bio_graph_arena {
+        struct bio_graph_arena_block*  blocks;
+        int                            next_capacity;
+};
+
+// vertex names interned into one pool and indexed by an open addressing hash table
+struct bio_graph_names {
+        char*                          pool;
+        int                            pool_size;
+        int                            pool_capacity;
+        int*                           offsets;        // per vertex offset into the pool, -1 when unnamed
+        int*                           slots;          // vertex ids, -1 when empty
+        int                            num_slots;      // power of two
+        int                            num_names;
+};
+
 struct bio_graph {
         int                            num_verts;
+        int                            vert_capacity;
+        int                            num_edges;
         struct bio_graph_vertex*       verts;
+        struct bio_graph_arena         arena;          // neighbour list nodes, only used when not frozen
+
+        // compressed sparse row adjacency, only valid when frozen
+        bool                           is_frozen;
+        int*                           row_offsets;    // num_verts + 1 entries
+        int*                           col_ids;        // row_offsets[num_verts] entries
+        f_Bio_Graph_Release            csr_release;    // set when the row arrays are borrowed
+        void*                          csr_release_data;
+
+        int*                           parent_ids;     // vertex ids in the graph this one was extracted from
+        struct bio_graph_names         names;
 };
 
 
+#define c_MinArenaBlockNodes        1024
+#define c_MaxArenaBlockNodes        (1 << 20)
+
+static void __bio_graph_arena_init(struct bio_graph_arena* self)
+{
+        self->blocks            = nullptr;
+        self->next_capacity     = c_MinArenaBlockNodes;
+}
+
+static void __bio_graph_arena_free(struct bio_graph_arena* self)
+{
+        struct bio_graph_arena_block* block = self->blocks;
+        while (block) {struct bio_graph_arena_block* t = block->next; free(block); block = t;}
+        __bio_graph_arena_init(self);
+}
+
+static struct bio_graph_list* __bio_graph_arena_alloc(struct bio_graph_arena* self, int num_nodes)
+{
+        struct bio_graph_arena_block* block = self->blocks;
+        if (block == nullptr || block->num_used + num_nodes > block->capacity) {
+                // blocks grow geometrically so a build takes a handful of allocations
+                int capacity = MAX(num_nodes, self->next_capacity);
+                block = malloc(sizeof(*block) + sizeof(block->nodes[0])*capacity);
+                block->next             = self->blocks;
+                block->num_used         = 0;
+                block->capacity         = capacity;
+                self->blocks            = block;
+                self->next_capacity     = MIN(2*self->next_capacity, c_MaxArenaBlockNodes);
+        }
+        struct bio_graph_list* nodes = &block->nodes[block->num_used];
+        block->num_used += num_nodes;
+        return nodes;
+}
+
+static void __bio_graph_init_lists(struct bio_graph* self)
+{
+        // one contiguous run of sentinel heads
+        struct bio_graph_list* heads = __bio_graph_arena_alloc(&self->arena, MAX(1, self->num_verts));
+        int i;
+        for (i = 0; i < self->num_verts; i ++) {
+                self->verts[i].head             = &heads[i];
+                self->verts[i].linked_vert      = self->verts[i].head;
+                self->verts[i].linked_vert->list_next = nullptr;
+                self->verts[i].linked_vert->vert_next = nullptr;
+        }
+}
+
+static void __bio_graph_free_lists(struct bio_graph* self)
+{
+        __bio_graph_arena_free(&self->arena);
+        int i;
+        for (i = 0; i < self->num_verts; i ++) {
+                self->verts[i].head             = nullptr;
+                self->verts[i].linked_vert      = nullptr;
+        }
+}
+
+static void __bio_graph_names_init(struct bio_graph_names* self)
+{
+        memset(self, 0, sizeof(*self));
+}
+
+static void __bio_graph_names_free(struct bio_graph_names* self)
+{
+        free(self->pool);
+        free(self->offsets);
+        free(self->slots);
+        memset(self, 0, sizeof(*self));
+}
+
+static uint32_t __bio_graph_hash_name(const char* name)
+{
+        // fnv-1a
+        uint32_t h = 2166136261u;
+        while (*name) {
+                h ^= (uint8_t) *name ++;
+                h *= 16777619u;
+        }
+        return h;
+}
+
+static int __bio_graph_names_find_slot(const struct bio_graph_names* self, const char* name)
+{
+        uint32_t mask = self->num_slots - 1;
+        uint32_t p = __bio_graph_hash_name(name) & mask;
+        while (self->slots[p] != -1 && strcmp(&self->pool[self->offsets[self->slots[p]]], name)) {
+                p = (p + 1) & mask;
+        }
+        return p;
+}
+
+static void __bio_graph_names_rehash(struct bio_graph_names* self, int num_slots)
+{
+        free(self->slots);
+        self->num_slots = num_slots;
+        self->slots     = malloc(sizeof(*self->slots)*num_slots);
+        int i;
+        for (i = 0; i < num_slots; i ++) {
+                self->slots[i] = -1;
+        }
+}
+
+// num_verts is the vertex capacity of the graph
+static bool __bio_graph_names_insert(struct bio_graph_names* self, int num_verts, int v, const char* name)
+{
+        if (self->offsets == nullptr) {
+                self->offsets = malloc(sizeof(*self->offsets)*MAX(1, num_verts));
+                int i;
+                for (i = 0; i < num_verts; i ++) {
+                        self->offsets[i] = -1;
+                }
+                __bio_graph_names_rehash(self, 64);
+        }
+        if (self->offsets[v] != -1) {
+                return false;
+        }
+        // keep the load factor under a half
+        if (2*(self->num_names + 1) > self->num_slots) {
+                __bio_graph_names_rehash(self, 2*self->num_slots);
+                int i;
+                for (i = 0; i < num_verts; i ++) {
+                        if (self->offsets[i] != -1) {
+                                self->slots[__bio_graph_names_find_slot(self, &self->pool[self->offsets[i]])] = i;
+                        }
+                }
+        }
+        int p = __bio_graph_names_find_slot(self, name);
+        if (self->slots[p] != -1) {
+                return false;
+        }
+        // intern the string
+        int l = strlen(name) + 1;
+        if (self->pool_size + l > self->pool_capacity) {
+                self->pool_capacity = MAX(2*self->pool_capacity, self->pool_size + l);
+                self->pool = realloc(self->pool, self->pool_capacity);
+        }
+        memcpy(&self->pool[self->pool_size], name, l);
+        self->offsets[v] = self->pool_size;
+        self->pool_size += l;
+        self->slots[p] = v;
+        self->num_names ++;
+        return true;
+}
+
 static void __bio_graph_init(struct bio_graph* self, int num_verts)
 {
-        self->verts     = malloc(sizeof(*self->verts)*num_verts);
+        self->verts     = malloc(sizeof(*self->verts)*MAX(1, num_verts));
         self->num_verts = num_verts;
+        self->vert_capacity = num_verts;
+        self->num_edges = 0;
+
+        self->is_frozen   = false;
+        self->row_offsets = nullptr;
+        self->col_ids     = nullptr;
+        self->csr_release = nullptr;
+        self->csr_release_data = nullptr;
+        self->parent_ids  = nullptr;
+        __bio_graph_names_init(&self->names);
 
         int i;
         for (i = 0; i < num_verts; i ++) {
                 self->verts[i].id               = i;
                 self->verts[i].degree           = 0;
-                self->verts[i].head             = malloc(sizeof(*self->verts[i].head));
-                self->verts[i].linked_vert      = self->verts[i].head;
-                self->verts[i].linked_vert->list_next = nullptr;
-                self->verts[i].linked_vert->vert_next = nullptr;
         }
+        __bio_graph_arena_init(&self->arena);
+        __bio_graph_init_lists(self);
+}
+
+static struct bio_graph* __bio_graph_create_frozen(int num_verts, int num_entries)
+{
+        // vertices and row arrays only, the caller fills in the adjacency
+        struct bio_graph* self = malloc(sizeof(*self));
+        self->verts     = malloc(sizeof(*self->verts)*MAX(1, num_verts));
+        self->num_verts = num_verts;
+        self->vert_capacity = num_verts;
+        self->num_edges = num_entries/2;
+
+        self->is_frozen   = true;
+        self->row_offsets = malloc(sizeof(*self->row_offsets)*(self->vert_capacity + 1));
+        self->col_ids     = malloc(sizeof(*self->col_ids)*MAX(1, num_entries));
+        self->csr_release = nullptr;
+        self->csr_release_data = nullptr;
+        self->parent_ids  = nullptr;
+        __bio_graph_names_init(&self->names);
+
+        int i;
+        for (i = 0; i < num_verts; i ++) {
+                self->verts[i].id               = i;
+                self->verts[i].degree           = 0;
+                self->verts[i].head             = nullptr;
+                self->verts[i].linked_vert      = nullptr;
+                self->verts[i].data             = nullptr;
+        }
+        __bio_graph_arena_init(&self->arena);
+        return self;
 }
 
+static int __bio_graph_compare_ids(const void* a, const void* b)
+{
+        int x = *(const int*) a;
+        int y = *(const int*) b;
+        return (x > y) - (x < y);
+}
+
+void bio_graph_freeze(struct bio_graph* self)
+{
+        if (self->is_frozen) {
+                return ;
+        }
+        // prefix sum of the degrees gives the row offsets
+        self->row_offsets = malloc(sizeof(*self->row_offsets)*(self->vert_capacity + 1));
+        self->row_offsets[0] = 0;
+        int i;
+        for (i = 0; i < self->num_verts; i ++) {
+                self->row_offsets[i + 1] = self->row_offsets[i] + self->verts[i].degree;
+        }
+        // copy the neighbour lists and sort them, so that rows come out the same as from the bulk build
+        self->col_ids = malloc(sizeof(*self->col_ids)*MAX(1, self->row_offsets[self->num_verts]));
+        for (i = 0; i < self->num_verts; i ++) {
+                int k = self->row_offsets[i];
+                struct bio_graph_list* list = self->verts[i].head;
+                while (list->list_next) {
+                        self->col_ids[k ++] = list->vert_next->id;
+                        list = list->list_next;
+                }
+                qsort(&self->col_ids[self->row_offsets[i]], self->verts[i].degree, sizeof(*self->col_ids),
+                      __bio_graph_compare_ids);
+        }
+        __bio_graph_free_lists(self);
+        self->is_frozen = true;
+}
+
+static void __bio_graph_free_csr(struct bio_graph* self)
+{
+        if (self->csr_release) {
+                self->csr_release(self->csr_release_data);
+        } else {
+                free(self->row_offsets);
+                free(self->col_ids);
+        }
+        self->row_offsets       = nullptr;
+        self->col_ids           = nullptr;
+        self->csr_release       = nullptr;
+        self->csr_release_data  = nullptr;
+}
+
+// borrowed row arrays are copied before they get modified
+static void __bio_graph_own_csr(struct bio_graph* self)
+{
+        if (self->csr_release == nullptr) {
+                return ;
+        }
+        int num_entries = self->row_offsets[self->num_verts];
+        int* row_offsets = malloc(sizeof(*row_offsets)*(self->vert_capacity + 1));
+        int* col_ids = malloc(sizeof(*col_ids)*MAX(1, num_entries));
+        memcpy(row_offsets, self->row_offsets, sizeof(*row_offsets)*(self->num_verts + 1));
+        memcpy(col_ids, self->col_ids, sizeof(*col_ids)*num_entries);
+        __bio_graph_free_csr(self);
+        self->row_offsets       = row_offsets;
+        self->col_ids           = col_ids;
+}
+
+static void __bio_graph_thaw(struct bio_graph* self)
+{
+        // rebuild the neighbour lists from the row arrays
+        __bio_graph_init_lists(self);
+        int i;
+        for (i = 0; i < self->num_verts; i ++) {
+                struct bio_graph_vertex* gv = &self->verts[i];
+                int k;
+                for (k = self->row_offsets[i]; k < self->row_offsets[i + 1]; k ++) {
+                        gv->linked_vert->vert_next      = &self->verts[self->col_ids[k]];
+                        gv->linked_vert->list_next      = __bio_graph_arena_alloc(&self->arena, 1);
+                        gv->linked_vert                 = gv->linked_vert->list_next;
+                }
+                gv->linked_vert->vert_next = nullptr;
+                gv->linked_vert->list_next = nullptr;
+        }
+        __bio_graph_free_csr(self);
+        self->is_frozen         = false;
+}
+
+// queries run on the frozen representation and never change the graph, so concurrent readers are
+// safe. every builder leaves the graph frozen except bio_graph_make_edge_undirected, whose callers
+// have to call bio_graph_freeze once they are done
 struct bio_graph* bio_graph_create(int num_verts)
 {
         struct bio_graph* self = malloc(sizeof(*self));
         __bio_graph_init(self, num_verts);
+        bio_graph_freeze(self);
+        return self;
+}
+
+struct bio_graph* bio_graph_create_from_csr(int num_verts, int* row_offsets, int* col_ids,
+                                            f_Bio_Graph_Release release, void* release_data)
+{
+        // the graph takes the row arrays over: freed with it when release is nullptr, otherwise
+        // they are borrowed (e.g. mapped from a file) and release is called instead
+        struct bio_graph* self = __bio_graph_create_frozen(num_verts, 0);
+        free(self->row_offsets);
+        free(self->col_ids);
+        self->row_offsets       = row_offsets;
+        self->col_ids           = col_ids;
+        self->csr_release       = release;
+        self->csr_release_data  = release_data;
+        self->num_edges         = row_offsets[num_verts]/2;
+        int i;
+        for (i = 0; i < num_verts; i ++) {
+                self->verts[i].degree = row_offsets[i + 1] - row_offsets[i];
+        }
         return self;
 }
 
@@ -51,19 +379,48 @@ void bio_graph_free(struct bio_graph* self)
         if (self == nullptr) {
                 return ;
         }
-        int i;
-        for (i = 0; i < self->num_verts; i ++) {
-                self->verts[i].degree           = 0;
-                struct bio_graph_list* list =  self->verts[i].head;
-                while (list) {struct bio_graph_list* t = list->list_next; free(list); list = t;}
+        if (self->is_frozen) {
+                __bio_graph_free_csr(self);
+        } else {
+                __bio_graph_free_lists(self);
         }
 
+        free(self->parent_ids);
+        __bio_graph_names_free(&self->names);
         free(self->verts);
         self->num_verts = 0;
         free(self);
 }
 
 
+int bio_graph_add_vertex(struct bio_graph* self)
+{
+        // the row arrays only refer to vertices by id, so the vertex table can move
+        bio_graph_freeze(self);
+        __bio_graph_own_csr(self);
+        if (self->num_verts == self->vert_capacity) {
+                int capacity = MAX(64, 2*self->vert_capacity);
+                self->verts = realloc(self->verts, sizeof(*self->verts)*capacity);
+                self->row_offsets = realloc(self->row_offsets, sizeof(*self->row_offsets)*(capacity + 1));
+                if (self->names.offsets) {
+                        self->names.offsets = realloc(self->names.offsets, sizeof(*self->names.offsets)*capacity);
+                        int i;
+                        for (i = self->vert_capacity; i < capacity; i ++) {
+                                self->names.offsets[i] = -1;
+                        }
+                }
+                self->vert_capacity = capacity;
+        }
+        int v = self->num_verts ++;
+        self->verts[v].id               = v;
+        self->verts[v].degree           = 0;
+        self->verts[v].head             = nullptr;
+        self->verts[v].linked_vert      = nullptr;
+        self->verts[v].data             = nullptr;
+        self->row_offsets[v + 1]        = self->row_offsets[v];
+        return v;
+}
+
 void bio_graph_make_edge_undirected(struct bio_graph* self, int v0, int v1)
 {
         // resolve cycle as a single dot
@@ -71,6 +428,9 @@ void bio_graph_make_edge_undirected(struct bio_graph* self, int v0, int v1)
                 self->verts[v0].id = v0;
                 return ;
         }
+        if (self->is_frozen) {
+                __bio_graph_thaw(self);
+        }
         // reject repetition
         struct bio_graph_list* list =  self->verts[v0].head;
         while (list) {
@@ -84,7 +444,7 @@ void bio_graph_make_edge_undirected(struct bio_graph* self, int v0, int v1)
         struct bio_graph_vertex* gv1 = &self->verts[v1];
         //gv0->id                         = v0;
         gv0->linked_vert->vert_next     = gv1;
-        gv0->linked_vert->list_next     = malloc(sizeof(*gv0));
+        gv0->linked_vert->list_next     = __bio_graph_arena_alloc(&self->arena, 1);
         gv0->linked_vert                = gv0->linked_vert->list_next;
         gv0->linked_vert->vert_next     = nullptr;
         gv0->linked_vert->list_next     = nullptr;
@@ -92,93 +452,573 @@ void bio_graph_make_edge_undirected(struct bio_graph* self, int v0, int v1)
 
         //gv1->id                         = v1;
         gv1->linked_vert->vert_next     = gv0;
-        gv1->linked_vert->list_next     = malloc(sizeof(*gv1));
+        gv1->linked_vert->list_next     = __bio_graph_arena_alloc(&self->arena, 1);
         gv1->linked_vert                = gv1->linked_vert->list_next;
         gv1->linked_vert->vert_next     = nullptr;
         gv1->linked_vert->list_next     = nullptr;
         gv1->degree ++;
+
+        self->num_edges ++;
 }
 
-static void __bio_graph_traverse_build_graph_dfs(const struct bio_graph_vertex* vert, bool* visited_vert,
-                                                 struct bio_graph* new_graph, int* num_vert)
+// an undirected edge keyed as (min << 32 | max) so that sorting groups the repetitions
+static uint64_t __bio_graph_edge_key(int v0, int v1)
 {
-        // copy current vertex
-        struct bio_graph_list* list = vert->head;
-        while (list->list_next) {
-                bio_graph_make_edge_undirected(new_graph, vert->id, list->vert_next->id);
-                list = list->list_next;
-        }
-        // mark visited and recurse
-        list = vert->head;
-        while (list->list_next) {
-                if (!visited_vert[list->vert_next->id]) {
-                        visited_vert[list->vert_next->id] = true;
-                        *num_vert = *num_vert + 1;
-                        __bio_graph_traverse_build_graph_dfs(list->vert_next, visited_vert, new_graph, num_vert);
+        uint32_t lo = (uint32_t) MIN(v0, v1);
+        uint32_t hi = (uint32_t) MAX(v0, v1);
+        return (uint64_t) lo << 32 | hi;
+}
+
+static void __bio_graph_sort_keys(uint64_t* keys, int num_keys)
+{
+        // lsd radix sort over 8-bit digits, digits that are the same for every key are skipped
+        uint64_t* tmp = malloc(sizeof(*tmp)*MAX(1, num_keys));
+        uint64_t* src = keys;
+        uint64_t* dst = tmp;
+        int shift;
+        for (shift = 0; shift < 64; shift += 8) {
+                int count[256] = {0};
+                int i;
+                for (i = 0; i < num_keys; i ++) {
+                        count[(src[i] >> shift) & 0xff] ++;
                 }
-                list = list->list_next;
+                if (num_keys == 0 || count[(src[0] >> shift) & 0xff] == num_keys) {
+                        continue;
+                }
+                int sum = 0;
+                for (i = 0; i < 256; i ++) {
+                        int c = count[i];
+                        count[i] = sum;
+                        sum += c;
+                }
+                for (i = 0; i < num_keys; i ++) {
+                        dst[count[(src[i] >> shift) & 0xff] ++] = src[i];
+                }
+                uint64_t* t = src; src = dst; dst = t;
+        }
+        if (src != keys) {
+                memcpy(keys, src, sizeof(*keys)*num_keys);
         }
+        free(tmp);
 }
 
-struct bio_graph* bio_graph_get_connected_components(const struct bio_graph* self, int* n_comps)
+static int __bio_graph_unique_keys(uint64_t* keys, int num_keys)
 {
-        bool* visited_vert = malloc(sizeof(*visited_vert)*self->num_verts);
+        int num_unique = 0;
         int i;
+        for (i = 0; i < num_keys; i ++) {
+                if (num_unique == 0 || keys[num_unique - 1] != keys[i]) {
+                        keys[num_unique ++] = keys[i];
+                }
+        }
+        return num_unique;
+}
+
+struct sort_pack {
+        uint64_t*                       keys;
+        int                             num_keys;
+        int*                            slice_sizes;    // unique keys left at the front of each slice
+        int*                            bounds;         // (num_threads + 1)*num_threads, where each key range starts in each slice
+        int*                            part_offsets;   // where each key range is merged to
+        int*                            part_sizes;     // unique keys of each merged range
+        uint64_t*                       merged;
+};
+
+static void __bio_graph_sort_slice_task(int thread_id, int num_threads, void* user_data)
+{
+        struct sort_pack* pack = user_data;
+        int begin = (long) pack->num_keys*thread_id/num_threads;
+        int end = (long) pack->num_keys*(thread_id + 1)/num_threads;
+        __bio_graph_sort_keys(&pack->keys[begin], end - begin);
+        pack->slice_sizes[thread_id] = __bio_graph_unique_keys(&pack->keys[begin], end - begin);
+}
+
+// first position in [lo, hi) of the sorted keys that is not below key
+static int __bio_graph_lower_bound(const uint64_t* keys, int lo, int hi, uint64_t key)
+{
+        while (lo < hi) {
+                int mid = lo + (hi - lo)/2;
+                if (keys[mid] < key) lo = mid + 1;
+                else hi = mid;
+        }
+        return lo;
+}
+
+// every thread merges one key range out of all the slices, equal keys share a range so the
+// repetitions across slices are dropped there as well
+static void __bio_graph_merge_range_task(int thread_id, int num_threads, void* user_data)
+{
+        struct sort_pack* pack = user_data;
+        const int* begins = &pack->bounds[thread_id*num_threads];
+        const int* ends = &pack->bounds[(thread_id + 1)*num_threads];
+        int* heads = malloc(sizeof(*heads)*num_threads);
+        memcpy(heads, begins, sizeof(*heads)*num_threads);
+        uint64_t* merged = &pack->merged[pack->part_offsets[thread_id]];
+        int num_unique = 0;
+        int t;
+        while (true) {
+                int min_t = -1;
+                for (t = 0; t < num_threads; t ++) {
+                        if (heads[t] < ends[t] && (min_t == -1 || pack->keys[heads[t]] < pack->keys[heads[min_t]])) {
+                                min_t = t;
+                        }
+                }
+                if (min_t == -1) {
+                        break;
+                }
+                uint64_t key = pack->keys[heads[min_t] ++];
+                if (num_unique == 0 || merged[num_unique - 1] != key) {
+                        merged[num_unique ++] = key;
+                }
+        }
+        pack->part_sizes[thread_id] = num_unique;
+        free(heads);
+}
+
+// packs the merged ranges back into the key array, one range per thread
+static void __bio_graph_pack_range_task(int thread_id, int num_threads, void* user_data)
+{
+        struct sort_pack* pack = user_data;
+        int offset = 0;
+        int p;
+        for (p = 0; p < thread_id; p ++) {
+                offset += pack->part_sizes[p];
+        }
+        memcpy(&pack->keys[offset], &pack->merged[pack->part_offsets[thread_id]],
+               sizeof(*pack->keys)*pack->part_sizes[thread_id]);
+}
+
+// every thread sorts and dedupes a slice. splitters sampled from the slices then cut the key space
+// into one range per thread, and the threads merge their ranges out of all the slices
+static int __bio_graph_sort_unique_keys_parallel(uint64_t* keys, int num_keys, int num_threads)
+{
+        struct sort_pack pack;
+        pack.keys               = keys;
+        pack.num_keys           = num_keys;
+        pack.slice_sizes        = malloc(sizeof(*pack.slice_sizes)*num_threads);
+        parallel_run(num_threads, __bio_graph_sort_slice_task, &pack);
+
+        // num_threads evenly spaced samples per slice, every num_threads-th sample is a splitter
+        int num_samples = 0;
+        uint64_t* samples = malloc(sizeof(*samples)*num_threads*num_threads);
+        int t, p;
+        for (t = 0; t < num_threads; t ++) {
+                int begin = (long) num_keys*t/num_threads;
+                for (p = 0; p < num_threads && pack.slice_sizes[t] > 0; p ++) {
+                        samples[num_samples ++] = pack.keys[begin + (long) pack.slice_sizes[t]*p/num_threads];
+                }
+        }
+        __bio_graph_sort_keys(samples, num_samples);
+        pack.bounds             = malloc(sizeof(*pack.bounds)*(num_threads + 1)*num_threads);
+        pack.part_offsets       = malloc(sizeof(*pack.part_offsets)*num_threads);
+        pack.part_sizes         = malloc(sizeof(*pack.part_sizes)*num_threads);
+        for (t = 0; t < num_threads; t ++) {
+                int begin = (long) num_keys*t/num_threads;
+                int end = begin + pack.slice_sizes[t];
+                pack.bounds[t] = begin;
+                pack.bounds[num_threads*num_threads + t] = end;
+                for (p = 1; p < num_threads; p ++) {
+                        uint64_t splitter = num_samples > 0 ? samples[(long) num_samples*p/num_threads] : 0;
+                        pack.bounds[p*num_threads + t] = __bio_graph_lower_bound(pack.keys, begin, end, splitter);
+                }
+        }
+        free(samples);
+        int offset = 0;
+        for (p = 0; p < num_threads; p ++) {
+                pack.part_offsets[p] = offset;
+                for (t = 0; t < num_threads; t ++) {
+                        offset += pack.bounds[(p + 1)*num_threads + t] - pack.bounds[p*num_threads + t];
+                }
+        }
+
+        pack.merged = malloc(sizeof(*pack.merged)*MAX(1, offset));
+        parallel_run(num_threads, __bio_graph_merge_range_task, &pack);
+        parallel_run(num_threads, __bio_graph_pack_range_task, &pack);
+        int num_unique = 0;
+        for (p = 0; p < num_threads; p ++) {
+                num_unique += pack.part_sizes[p];
+        }
+        free(pack.merged);
+        free(pack.part_sizes);
+        free(pack.part_offsets);
+        free(pack.bounds);
+        free(pack.slice_sizes);
+        return num_unique;
+}
+
+#define c_MinParallelSortKeys           (1 << 18)
+
+void bio_graph_make_edges_undirected(struct bio_graph* self, const int* edges, int num_edges)
+{
+        bio_graph_freeze(self);
+        __bio_graph_own_csr(self);
+        // collect the existing edges and the new batch, self-loops and out of range ids are dropped
+        int num_existing = self->num_edges;
+        uint64_t* keys = malloc(sizeof(*keys)*MAX(1, num_existing + num_edges));
+        int num_keys = 0;
+        int i, k;
+        for (i = 0; i < self->num_verts; i ++) {
+                for (k = self->row_offsets[i]; k < self->row_offsets[i + 1]; k ++) {
+                        if (i < self->col_ids[k]) {
+                                keys[num_keys ++] = __bio_graph_edge_key(i, self->col_ids[k]);
+                        }
+                }
+        }
+        for (i = 0; i < num_edges; i ++) {
+                int v0 = edges[2*i + 0];
+                int v1 = edges[2*i + 1];
+                if (v0 == v1 || v0 < 0 || v1 < 0 || v0 >= self->num_verts || v1 >= self->num_verts) {
+                        continue;
+                }
+                keys[num_keys ++] = __bio_graph_edge_key(v0, v1);
+        }
+        // reject repetition
+        int num_threads = parallel_get_num_threads();
+        int num_unique;
+        if (num_threads > 1 && num_keys >= c_MinParallelSortKeys) {
+                num_unique = __bio_graph_sort_unique_keys_parallel(keys, num_keys, num_threads);
+        } else {
+                __bio_graph_sort_keys(keys, num_keys);
+                num_unique = __bio_graph_unique_keys(keys, num_keys);
+        }
+        // rebuild the row arrays from the unique edges
+        for (i = 0; i < self->num_verts; i ++) {
+                self->verts[i].degree = 0;
+        }
+        for (i = 0; i < num_unique; i ++) {
+                self->verts[keys[i] >> 32].degree ++;
+                self->verts[keys[i] & 0xffffffff].degree ++;
+        }
+        self->row_offsets[0] = 0;
         for (i = 0; i < self->num_verts; i ++) {
-                visited_vert[i] = false;
+                self->row_offsets[i + 1] = self->row_offsets[i] + self->verts[i].degree;
         }
-        struct bio_graph* new_graphs = malloc(sizeof(*new_graphs)*self->num_verts);
-        int num_connected = 0;
+        free(self->col_ids);
+        self->col_ids = malloc(sizeof(*self->col_ids)*MAX(1, 2*num_unique));
+        int* cursor = malloc(sizeof(*cursor)*MAX(1, self->num_verts));
+        memcpy(cursor, self->row_offsets, sizeof(*cursor)*self->num_verts);
+        for (i = 0; i < num_unique; i ++) {
+                int v0 = keys[i] >> 32;
+                int v1 = keys[i] & 0xffffffff;
+                self->col_ids[cursor[v0] ++] = v1;
+                self->col_ids[cursor[v1] ++] = v0;
+        }
+        free(cursor);
+        free(keys);
+        self->num_edges = num_unique;
+}
+
+// iterative depth first traversal, the explicit stack replays the order of the recursive walk
+struct bio_graph_frame {
+        int                             vert;
+        int                             next;   // cursor into the row of vert
+};
+
+struct bio_graph_traversal {
+        bool*                           visited_vert;
+        struct bio_graph_frame*         stack;
+};
+
+static void __bio_graph_traversal_init(struct bio_graph_traversal* self, int num_verts)
+{
+        self->visited_vert      = malloc(sizeof(*self->visited_vert)*MAX(1, num_verts));
+        self->stack             = malloc(sizeof(*self->stack)*MAX(1, num_verts));
+        int i;
+        for (i = 0; i < num_verts; i ++) {
+                self->visited_vert[i] = false;
+        }
+}
+
+static void __bio_graph_traversal_free(struct bio_graph_traversal* self)
+{
+        free(self->visited_vert);
+        free(self->stack);
+        memset(self, 0, sizeof(*self));
+}
+
+// gives every vertex reachable from root the label
+static void __bio_graph_traverse(const struct bio_graph* self, struct bio_graph_traversal* trav, int root,
+                                 int* labels, int label)
+{
+        // every vertex is pushed at most once, so the stack never exceeds num_verts frames
+        bool* visited_vert = trav->visited_vert;
+        struct bio_graph_frame* stack = trav->stack;
+        int top = 0;
+
+        visited_vert[root] = true;
+        labels[root] = label;
+        stack[top].vert = root;
+        stack[top].next = self->row_offsets[root];
+        top ++;
+        while (top > 0) {
+                struct bio_graph_frame* frame = &stack[top - 1];
+                int end = self->row_offsets[frame->vert + 1];
+                while (frame->next < end && visited_vert[self->col_ids[frame->next]]) {
+                        frame->next ++;
+                }
+                if (frame->next == end) {
+                        top --;
+                        continue;
+                }
+                // mark visited and descend
+                int w = self->col_ids[frame->next ++];
+                visited_vert[w] = true;
+                labels[w] = label;
+                stack[top].vert = w;
+                stack[top].next = self->row_offsets[w];
+                top ++;
+        }
+}
+
+static void __bio_graph_label_components_serial(const struct bio_graph* self, int* labels)
+{
+        struct bio_graph_traversal trav;
+        __bio_graph_traversal_init(&trav, self->num_verts);
+        int num_comps = 0;
+        int i;
         for (i = 0; i < self->num_verts; i ++) {
-                if (!visited_vert[i]) {
-                        visited_vert[i] = true;
-                        __bio_graph_init(&new_graphs[num_connected], self->num_verts);
-                        int num_verts = 0;
-                        __bio_graph_traverse_build_graph_dfs(&self->verts[i], visited_vert, &new_graphs[num_connected], &num_verts);
-                        new_graphs[num_connected].num_verts = num_verts;
-                        num_connected ++;
+                if (!trav.visited_vert[i]) {
+                        __bio_graph_traverse(self, &trav, i, labels, num_comps ++);
+                }
+        }
+        __bio_graph_traversal_free(&trav);
+}
+
+// rows [begin, end) of a thread, balanced by the number of edges rather than of vertices
+static void __bio_graph_partition_rows(const struct bio_graph* self, int thread_id, int num_threads, int* begin, int* end)
+{
+        int num_entries = self->row_offsets[self->num_verts];
+        int t;
+        for (t = 0; t < 2; t ++) {
+                long target = (long) num_entries*(thread_id + t)/num_threads;
+                int lo = 0, hi = self->num_verts;
+                while (lo < hi) {
+                        int mid = (lo + hi)/2;
+                        if (self->row_offsets[mid] < target) lo = mid + 1;
+                        else hi = mid;
                 }
+                if (t == 0) *begin = lo;
+                else *end = thread_id + 1 == num_threads ? self->num_verts : lo;
         }
-        free(visited_vert);
-        *n_comps = num_connected;
-        struct bio_graph* o = malloc(sizeof(*o)*num_connected);
-        for (i = 0; i < num_connected; i ++) {
-                o[i] = new_graphs[i];
+}
+
+// lock-free union-find, a root is always linked under the smaller root so that
+// every component ends up rooted at its smallest vertex id
+static int __bio_graph_uf_find(int* parent, int v)
+{
+        while (true) {
+                int p = __atomic_load_n(&parent[v], __ATOMIC_RELAXED);
+                if (p == v) {
+                        return v;
+                }
+                int gp = __atomic_load_n(&parent[p], __ATOMIC_RELAXED);
+                if (gp != p) {
+                        // path halving, losing the race is harmless
+                        __atomic_compare_exchange_n(&parent[v], &p, gp, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+                }
+                v = gp;
         }
-        free(new_graphs);
-        return o;
 }
 
-static void __bio_graph_traverse_dfs(const struct bio_graph_vertex* vert, bool* visited_vert)
+static void __bio_graph_uf_union(int* parent, int v0, int v1)
 {
-        // mark visited and recurse
-        struct bio_graph_list* list = vert->head;
-        while (list->list_next) {
-                if (!visited_vert[list->vert_next->id]) {
-                        visited_vert[list->vert_next->id] = true;
-                        __bio_graph_traverse_dfs(list->vert_next, visited_vert);
+        while (true) {
+                int r0 = __bio_graph_uf_find(parent, v0);
+                int r1 = __bio_graph_uf_find(parent, v1);
+                if (r0 == r1) {
+                        return ;
+                }
+                int hi = MAX(r0, r1);
+                int lo = MIN(r0, r1);
+                if (__atomic_compare_exchange_n(&parent[hi], &hi, lo, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                        return ;
+                }
+        }
+}
+
+struct union_find_pack {
+        const struct bio_graph*         graph;
+        int*                            parent;
+};
+
+static void __bio_graph_uf_link_task(int thread_id, int num_threads, void* user_data)
+{
+        struct union_find_pack* pack = user_data;
+        const struct bio_graph* self = pack->graph;
+        int begin, end;
+        __bio_graph_partition_rows(self, thread_id, num_threads, &begin, &end);
+        int v, k;
+        for (v = begin; v < end; v ++) {
+                for (k = self->row_offsets[v]; k < self->row_offsets[v + 1]; k ++) {
+                        if (v < self->col_ids[k]) {
+                                __bio_graph_uf_union(pack->parent, v, self->col_ids[k]);
+                        }
                 }
-                list = list->list_next;
         }
 }
 
+static void __bio_graph_uf_flatten_task(int thread_id, int num_threads, void* user_data)
+{
+        struct union_find_pack* pack = user_data;
+        int n = pack->graph->num_verts;
+        int begin = (long) n*thread_id/num_threads;
+        int end = (long) n*(thread_id + 1)/num_threads;
+        int v;
+        for (v = begin; v < end; v ++) {
+                __atomic_store_n(&pack->parent[v], __bio_graph_uf_find(pack->parent, v), __ATOMIC_RELAXED);
+        }
+}
+
+static void __bio_graph_label_components_parallel(const struct bio_graph* self, int* labels, int num_threads)
+{
+        struct union_find_pack pack;
+        pack.graph      = self;
+        pack.parent     = labels;
+        int i;
+        for (i = 0; i < self->num_verts; i ++) {
+                labels[i] = i;
+        }
+        parallel_run(num_threads, __bio_graph_uf_link_task, &pack);
+        parallel_run(num_threads, __bio_graph_uf_flatten_task, &pack);
+        // roots are the smallest ids, so numbering them in order matches the serial walk
+        int num_comps = 0;
+        for (i = 0; i < self->num_verts; i ++) {
+                labels[i] = labels[i] == i ? num_comps ++ : labels[labels[i]];
+        }
+}
+
+#define c_MinParallelComponentEdges     (1 << 16)
+
+int* bio_graph_find_connected_components(const struct bio_graph* self, int* n_comps, int** comp_sizes)
+{
+        assert(self->is_frozen);
+        int* labels = malloc(sizeof(*labels)*MAX(1, self->num_verts));
+        int num_threads = parallel_get_num_threads();
+        if (num_threads > 1 && self->row_offsets[self->num_verts] >= c_MinParallelComponentEdges) {
+                __bio_graph_label_components_parallel(self, labels, num_threads);
+        } else {
+                __bio_graph_label_components_serial(self, labels);
+        }
+        int num_comps = 0;
+        int i;
+        for (i = 0; i < self->num_verts; i ++) {
+                num_comps = MAX(num_comps, labels[i] + 1);
+        }
+        if (comp_sizes) {
+                int* sizes = malloc(sizeof(*sizes)*MAX(1, num_comps));
+                memset(sizes, 0, sizeof(*sizes)*num_comps);
+                for (i = 0; i < self->num_verts; i ++) {
+                        sizes[labels[i]] ++;
+                }
+                *comp_sizes = sizes;
+        }
+        *n_comps = num_comps;
+        return labels;
+}
+
 int bio_graph_count_connected_components(const struct bio_graph* self)
 {
-        bool* visited_vert = malloc(sizeof(*visited_vert)*self->num_verts);
+        int num_comps;
+        free(bio_graph_find_connected_components(self, &num_comps, nullptr));
+        return num_comps;
+}
+
+// builds the sub-graph induced by a whole component, local_ids maps parent ids to ids within the component
+static struct bio_graph* __bio_graph_extract_component(const struct bio_graph* self, const int* members, int num_members,
+                                                       const int* local_ids)
+{
+        int num_entries = 0;
+        int i, k;
+        for (i = 0; i < num_members; i ++) {
+                num_entries += self->verts[members[i]].degree;
+        }
+        struct bio_graph* comp = __bio_graph_create_frozen(num_members, num_entries);
+        comp->parent_ids = malloc(sizeof(*comp->parent_ids)*MAX(1, num_members));
+        comp->row_offsets[0] = 0;
+        for (i = 0; i < num_members; i ++) {
+                int v = members[i];
+                int* row = &comp->col_ids[comp->row_offsets[i]];
+                for (k = self->row_offsets[v]; k < self->row_offsets[v + 1]; k ++) {
+                        *row ++ = local_ids[self->col_ids[k]];
+                }
+                comp->verts[i].degree   = self->verts[v].degree;
+                comp->row_offsets[i + 1] = comp->row_offsets[i] + comp->verts[i].degree;
+                comp->parent_ids[i]     = v;
+                if (bio_graph_get_vertex_name(self, v)) {
+                        bio_graph_set_vertex_name(comp, i, bio_graph_get_vertex_name(self, v));
+                }
+        }
+        return comp;
+}
+
+struct bio_graph** bio_graph_get_connected_components(const struct bio_graph* self, int* n_comps)
+{
+        int num_comps;
+        int* comp_sizes;
+        int* labels = bio_graph_find_connected_components(self, &num_comps, &comp_sizes);
+        // counting sort the vertices by component, ids inside a component keep their relative order
+        int* comp_offsets = malloc(sizeof(*comp_offsets)*(num_comps + 1));
+        comp_offsets[0] = 0;
         int i;
+        for (i = 0; i < num_comps; i ++) {
+                comp_offsets[i + 1] = comp_offsets[i] + comp_sizes[i];
+        }
+        int* members = malloc(sizeof(*members)*MAX(1, self->num_verts));
+        int* local_ids = malloc(sizeof(*local_ids)*MAX(1, self->num_verts));
+        for (i = 0; i < num_comps; i ++) {
+                comp_sizes[i] = 0;
+        }
         for (i = 0; i < self->num_verts; i ++) {
-                visited_vert[i] = false;
+                int c = labels[i];
+                local_ids[i] = comp_sizes[c] ++;
+                members[comp_offsets[c] + local_ids[i]] = i;
+        }
+        struct bio_graph** comps = malloc(sizeof(*comps)*MAX(1, num_comps));
+        for (i = 0; i < num_comps; i ++) {
+                comps[i] = __bio_graph_extract_component(self, &members[comp_offsets[i]], comp_sizes[i], local_ids);
         }
-        int num_connected = 0;
+        free(local_ids);
+        free(members);
+        free(comp_offsets);
+        free(comp_sizes);
+        free(labels);
+        *n_comps = num_comps;
+        return comps;
+}
+
+// ties go to the component that holds the smallest vertex id
+struct bio_graph* bio_graph_get_largest_connected_component(const struct bio_graph* self)
+{
+        int num_comps;
+        int* comp_sizes;
+        int* labels = bio_graph_find_connected_components(self, &num_comps, &comp_sizes);
+        if (num_comps == 0) {
+                free(comp_sizes);
+                free(labels);
+                return bio_graph_create(0);
+        }
+        int largest = 0;
+        int i;
+        for (i = 1; i < num_comps; i ++) {
+                if (comp_sizes[i] > comp_sizes[largest]) {
+                        largest = i;
+                }
+        }
+        // only the members of the largest component are collected
+        int* members = malloc(sizeof(*members)*MAX(1, comp_sizes[largest]));
+        int* local_ids = labels;
+        int num_members = 0;
         for (i = 0; i < self->num_verts; i ++) {
-                if (!visited_vert[i]) {
-                        visited_vert[i] = true;
-                        __bio_graph_traverse_dfs(&self->verts[i], visited_vert);
-                        num_connected ++;
+                if (labels[i] == largest) {
+                        members[num_members] = i;
+                        local_ids[i] = num_members ++;
                 }
         }
-        free(visited_vert);
-        return num_connected;
+        struct bio_graph* comp = __bio_graph_extract_component(self, members, num_members, local_ids);
+        free(members);
+        free(comp_sizes);
+        free(labels);
+        return comp;
 }
 
 int* bio_graph_find_deg_distri(const struct bio_graph* self, int* num_distri)
@@ -210,42 +1050,57 @@ int bio_graph_get_vertex_num(const struct bio_graph* g)
         return g->num_verts;
 }
 
-static void __bio_graph_traverse_dfs2(const struct bio_graph_vertex* vert, bool* visited_vert,
-                                      f_Bio_Graph_Edge_Visitor visitor, void* user_data)
+void bio_graph_get_csr(const struct bio_graph* g, const int** row_offsets, const int** col_ids)
 {
-        // copy current vertex
-        struct bio_graph_list* list = vert->head;
-        while (list->list_next) {
-                if (!visited_vert[list->vert_next->id]) {
-                        visitor(vert, list->vert_next, user_data);
-                }
-                list = list->list_next;
+        assert(g->is_frozen);
+        *row_offsets    = g->row_offsets;
+        *col_ids        = g->col_ids;
+}
+
+int bio_graph_get_edge_num(const struct bio_graph* g)
+{
+        return g->num_edges;
+}
+
+bool bio_graph_set_vertex_name(struct bio_graph* self, int v, const char* name)
+{
+        return __bio_graph_names_insert(&self->names, self->vert_capacity, v, name);
+}
+
+const char* bio_graph_get_vertex_name(const struct bio_graph* self, int v)
+{
+        if (self->names.offsets == nullptr || self->names.offsets[v] == -1) {
+                return nullptr;
         }
-        // mark visited and recurse
-        list = vert->head;
-        while (list->list_next) {
-                if (!visited_vert[list->vert_next->id]) {
-                        visited_vert[list->vert_next->id] = true;
-                        __bio_graph_traverse_dfs2(list->vert_next, visited_vert, visitor, user_data);
-                }
-                list = list->list_next;
+        return &self->names.pool[self->names.offsets[v]];
+}
+
+int bio_graph_find_vertex_by_name(const struct bio_graph* self, const char* name)
+{
+        if (self->names.num_names == 0) {
+                return -1;
         }
+        return self->names.slots[__bio_graph_names_find_slot(&self->names, name)];
+}
+
+int bio_graph_get_parent_id(const struct bio_graph* g, int v)
+{
+        return g->parent_ids ? g->parent_ids[v] : v;
 }
 
 void bio_graph_visit_edges(const struct bio_graph* self, f_Bio_Graph_Edge_Visitor visitor, void* user_data)
 {
-        bool* visited_vert = malloc(sizeof(*visited_vert)*self->num_verts);
-        int i;
-        for (i = 0; i < self->num_verts; i ++) {
-                visited_vert[i] = false;
-        }
-        for (i = 0; i < self->num_verts; i ++) {
-                if (!visited_vert[i]) {
-                        visited_vert[i] = true;
-                        __bio_graph_traverse_dfs2(&self->verts[i], visited_vert, visitor, user_data);
+        assert(self->is_frozen);
+        // each undirected edge is stored in both rows, report it from the row of its smaller end
+        int v, k;
+        for (v = 0; v < self->num_verts; v ++) {
+                for (k = self->row_offsets[v]; k < self->row_offsets[v + 1]; k ++) {
+                        int w = self->col_ids[k];
+                        if (v < w) {
+                                visitor(&self->verts[v], &self->verts[w], user_data);
+                        }
                 }
         }
-        free(visited_vert);
 }
 
 void bio_graph_visit_vertices(const struct bio_graph* self, f_Bio_Graph_Vertex_Visitor visitor, void* user_data)
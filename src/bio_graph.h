@@ -9,18 +9,32 @@ struct bio_graph;
 
 typedef void (*f_Bio_Graph_Edge_Visitor) (const struct bio_graph_vertex* v0, const struct bio_graph_vertex* v1, void* user_data);
 typedef void (*f_Bio_Graph_Vertex_Visitor) (const struct bio_graph_vertex* v, void* user_data);
+typedef void (*f_Bio_Graph_Release) (void* user_data);
 
 
 struct bio_graph*       bio_graph_create(int num_verts);
+struct bio_graph*       bio_graph_create_from_csr(int num_verts, int* row_offsets, int* col_ids,
+                                                  f_Bio_Graph_Release release, void* release_data);
 void                    bio_graph_free(struct bio_graph* self);
+int                     bio_graph_add_vertex(struct bio_graph* self);
 void                    bio_graph_make_edge_undirected(struct bio_graph* self, int v0, int v1);
-struct bio_graph*       bio_graph_get_connected_components(const struct bio_graph* self, int* n_comps);
+void                    bio_graph_make_edges_undirected(struct bio_graph* self, const int* edges, int num_edges);
+void                    bio_graph_freeze(struct bio_graph* self);
+struct bio_graph**      bio_graph_get_connected_components(const struct bio_graph* self, int* n_comps);
+struct bio_graph*       bio_graph_get_largest_connected_component(const struct bio_graph* self);
 int                     bio_graph_count_connected_components(const struct bio_graph* self);
+int*                    bio_graph_find_connected_components(const struct bio_graph* self, int* n_comps, int** comp_sizes);
 int*                    bio_graph_find_deg_distri(const struct bio_graph* self, int* num_distri);
 struct bio_graph*       bio_graph_get_graal_alignment(struct bio_graph* g, struct bio_graph* h);
 struct bio_graph*       bio_graph_get_sana_alignment(struct bio_graph* g, struct bio_graph* h);
 
 int                     bio_graph_get_vertex_num(const struct bio_graph* g);
+int                     bio_graph_get_edge_num(const struct bio_graph* g);
+void                    bio_graph_get_csr(const struct bio_graph* g, const int** row_offsets, const int** col_ids);
+int                     bio_graph_get_parent_id(const struct bio_graph* g, int v);
+bool                    bio_graph_set_vertex_name(struct bio_graph* self, int v, const char* name);
+const char*             bio_graph_get_vertex_name(const struct bio_graph* self, int v);
+int                     bio_graph_find_vertex_by_name(const struct bio_graph* self, const char* name);
 void                    bio_graph_visit_edges(const struct bio_graph* self, f_Bio_Graph_Edge_Visitor visitor, void* user_data);
 void                    bio_graph_visit_vertices(const struct bio_graph* self, f_Bio_Graph_Vertex_Visitor visitor, void* user_data);
 
@@ -0,0 +1,68 @@
+#ifndef GRAPH_BGB_H_INCLUDED
+#define GRAPH_BGB_H_INCLUDED
+
+// .bgb binary graph snapshot, laid out so it can be mapped and used in place:
+//
+//   struct bgb_header
+//   int32  row_offsets[num_verts + 1]
+//   int32  col_ids[num_entries]
+//   int32  name_offsets[num_verts]        only when name_pool_size > 0, -1 when unnamed
+//   char   name_pool[name_pool_size]      nul terminated names, zero padded to 8 bytes
+//
+// all fields are in the byte order of the writer, endian_tag tells which one it was.
+// checksum is a fletcher-64 over the 32-bit words that follow the header.
+
+#define c_BgbMagic              "BGB"
+#define c_BgbEndianTag          0x01020304u
+#define c_BgbVersion            1
+
+struct bgb_header {
+        char            magic[4];
+        uint32_t        endian_tag;
+        uint32_t        version;
+        int32_t         num_verts;
+        uint64_t        num_entries;
+        uint64_t        name_pool_size;
+        uint64_t        checksum;
+};
+
+struct bgb_checksum {
+        uint64_t        sum1;
+        uint64_t        sum2;
+};
+
+static inline size_t bgb_padded_pool_size(uint64_t pool_size)
+{
+        return (pool_size + 7) & ~(uint64_t) 7;
+}
+
+static inline void bgb_checksum_init(struct bgb_checksum* self)
+{
+        self->sum1 = 0;
+        self->sum2 = 0;
+}
+
+static inline void bgb_checksum_update(struct bgb_checksum* self, const uint32_t* words, size_t num_words, bool swap)
+{
+        // sums stay below 2^64 for 92679 words before they have to be reduced
+        while (num_words > 0) {
+                size_t n = MIN(num_words, (size_t) 92679);
+                size_t i;
+                for (i = 0; i < n; i ++) {
+                        self->sum1 += swap ? __builtin_bswap32(words[i]) : words[i];
+                        self->sum2 += self->sum1;
+                }
+                self->sum1 %= 0xffffffffu;
+                self->sum2 %= 0xffffffffu;
+                words += n;
+                num_words -= n;
+        }
+}
+
+static inline uint64_t bgb_checksum_get(const struct bgb_checksum* self)
+{
+        return (self->sum2 << 32) | self->sum1;
+}
+
+
+#endif // GRAPH_BGB_H_INCLUDED
@@ -1,44 +1,74 @@
 #include "common.h"
 #include "bio_graph.h"
 #include "graph_display.h"
+#include "graph_display_kernel.h"
+#include "parallel.h"
 
-struct display_vertex {
-        float           acc_x;
-        float           acc_y;
-
-        float           pos_x;
-        float           pos_y;
-
-        float           mass;
-};
-
+// layout state as structure of arrays, so the kernels can stream positions into vector registers
 struct display_data {
-        struct display_vertex*  vertices;
+        float*                  pos_x;
+        float*                  pos_y;
+        float*                  acc_x;
+        float*                  acc_y;
+        float*                  inv_mass;       // 1/max(1, degree), fixed for the bound graph
+        float*                  heat;           // per vertex share of the step, see the adaptive cooling
+        float*                  last_ax;        // acceleration of the previous step
+        float*                  last_ay;
         int                     num_verts;
         float                   x_scale;
         float                   y_scale;
         struct bio_graph*       graph;
+        // every undirected edge once, grouped by its smaller end. the springs are stored for both
+        // ends so that either reads its own contiguously
+        int*                    up_offsets;
+        int*                    up_ends;        // larger end of each edge
+        int*                    lower_offsets;  // per vertex its edges from smaller vertices
+        int*                    lower_slots;    // per edge its place in the lower order
+        float*                  up_springs;     // 2 floats per edge, in up order
+        float*                  lower_springs;  // 2 floats per edge, in lower order
 };
 
 static void __data_init(struct display_data* self)
 {
-        self->vertices  = nullptr;
+        self->pos_x     = nullptr;
+        self->pos_y     = nullptr;
+        self->acc_x     = nullptr;
+        self->acc_y     = nullptr;
+        self->inv_mass  = nullptr;
+        self->heat      = nullptr;
+        self->last_ax   = nullptr;
+        self->last_ay   = nullptr;
+        self->num_verts = 0;
         self->graph     = nullptr;
+        self->up_offsets        = nullptr;
+        self->up_ends           = nullptr;
+        self->lower_offsets     = nullptr;
+        self->lower_slots       = nullptr;
+        self->up_springs        = nullptr;
+        self->lower_springs     = nullptr;
         self->x_scale   = 1.0f;
         self->y_scale   = 1.0f;
 }
 
 static void __data_free(struct display_data* self)
 {
-        free(self->vertices);
+        free(self->pos_x);
+        free(self->pos_y);
+        free(self->acc_x);
+        free(self->acc_y);
+        free(self->inv_mass);
+        free(self->heat);
+        free(self->last_ax);
+        free(self->last_ay);
+        free(self->up_offsets);
+        free(self->up_ends);
+        free(self->lower_offsets);
+        free(self->lower_slots);
+        free(self->up_springs);
+        free(self->lower_springs);
         memset(self, 0, sizeof(*self));
 }
 
-static struct display_vertex* __data_get_vertices(struct display_data* self)
-{
-        return self->vertices;
-}
-
 static int __data_get_vertex_num(struct display_data* self)
 {
         return self->num_verts;
@@ -52,14 +82,14 @@ static void __data_get_scale(struct display_data* self, float* x_scale, float* y
 
 static void __data_find_system_scale(struct display_data* self, float* min_x, float* min_y, float* max_x, float* max_y)
 {
-        float max_x_tmp = FLT_MIN, min_x_tmp = FLT_MAX;
-        float max_y_tmp = FLT_MIN, min_y_tmp = FLT_MAX;;
+        float max_x_tmp = -FLT_MAX, min_x_tmp = FLT_MAX;
+        float max_y_tmp = -FLT_MAX, min_y_tmp = FLT_MAX;
         int j;
         for (j = 0; j < self->num_verts; j ++) {
-                min_x_tmp = MIN(min_x_tmp, self->vertices[j].pos_x);
-                max_x_tmp = MAX(max_x_tmp, self->vertices[j].pos_x);
-                min_y_tmp = MIN(min_y_tmp, self->vertices[j].pos_y);
-                max_y_tmp = MAX(max_y_tmp, self->vertices[j].pos_y);
+                min_x_tmp = MIN(min_x_tmp, self->pos_x[j]);
+                max_x_tmp = MAX(max_x_tmp, self->pos_x[j]);
+                min_y_tmp = MIN(min_y_tmp, self->pos_y[j]);
+                max_y_tmp = MAX(max_y_tmp, self->pos_y[j]);
         }
         *min_x = min_x_tmp;
         *min_y = min_y_tmp;
@@ -78,18 +108,11 @@ static void __data_redefine_system_position(struct display_data* self)
 
         int j;
         for (j = 0; j < self->num_verts; j ++) {
-                self->vertices[j].pos_x -= min_x;
-                self->vertices[j].pos_y -= min_y;
+                self->pos_x[j] -= min_x;
+                self->pos_y[j] -= min_y;
         }
 }
 
-static void __display_bind_data(const struct bio_graph_vertex* v0, void* user_data)
-{
-        struct display_data* self = user_data;
-        int v0_id = bio_graph_vertex_get_id(v0);
-        bio_graph_vertex_bind_data((struct bio_graph_vertex*) v0, &self->vertices[v0_id]);
-}
-
 static const float c_MetersPerParticle = 2.0f;
 
 static void __data_retrieve_data_from_graph(struct display_data* self, struct bio_graph* graph)
@@ -97,10 +120,65 @@ static void __data_retrieve_data_from_graph(struct display_data* self, struct bi
         // initialize vector data
         self->graph = graph;
         self->num_verts = bio_graph_get_vertex_num(self->graph);
-        if (self->vertices) free(self->vertices);
-        self->vertices = malloc(sizeof(*self->vertices)*self->num_verts);
-        // bind to the graph vertex
-        bio_graph_visit_vertices(self->graph, __display_bind_data, self);
+        size_t size = sizeof(float)*MAX(1, self->num_verts);
+        free(self->pos_x);
+        free(self->pos_y);
+        free(self->acc_x);
+        free(self->acc_y);
+        free(self->inv_mass);
+        free(self->heat);
+        free(self->last_ax);
+        free(self->last_ay);
+        self->pos_x = malloc(size);
+        self->pos_y = malloc(size);
+        self->acc_x = malloc(size);
+        self->acc_y = malloc(size);
+        self->inv_mass = malloc(size);
+        self->heat = malloc(size);
+        self->last_ax = malloc(size);
+        self->last_ay = malloc(size);
+        const int* row_offsets;
+        const int* col_ids;
+        bio_graph_get_csr(self->graph, &row_offsets, &col_ids);
+        int n = self->num_verts;
+        int v, k;
+        for (v = 0; v < n; v ++) {
+                self->inv_mass[v] = 1.0f/MAX(1, row_offsets[v + 1] - row_offsets[v]);
+        }
+        // edges in row order, then counting sorted by their larger end
+        free(self->up_offsets);
+        free(self->up_ends);
+        free(self->lower_offsets);
+        free(self->lower_slots);
+        free(self->up_springs);
+        free(self->lower_springs);
+        int capacity = MAX(1, row_offsets[n]);
+        self->up_offsets = malloc(sizeof(*self->up_offsets)*(n + 1));
+        self->up_ends = malloc(sizeof(*self->up_ends)*capacity);
+        self->lower_offsets = calloc(n + 1, sizeof(*self->lower_offsets));
+        self->lower_slots = malloc(sizeof(*self->lower_slots)*capacity);
+        self->up_springs = malloc(sizeof(*self->up_springs)*2*capacity);
+        self->lower_springs = malloc(sizeof(*self->lower_springs)*2*capacity);
+        int num_edges = 0;
+        for (v = 0; v < n; v ++) {
+                self->up_offsets[v] = num_edges;
+                for (k = row_offsets[v]; k < row_offsets[v + 1]; k ++) {
+                        if (v < col_ids[k]) {
+                                self->up_ends[num_edges ++] = col_ids[k];
+                                self->lower_offsets[col_ids[k] + 1] ++;
+                        }
+                }
+        }
+        self->up_offsets[n] = num_edges;
+        for (v = 0; v < n; v ++) {
+                self->lower_offsets[v + 1] += self->lower_offsets[v];
+        }
+        int* fill = malloc(sizeof(*fill)*MAX(1, n));
+        memcpy(fill, self->lower_offsets, sizeof(*fill)*n);
+        for (k = 0; k < num_edges; k ++) {
+                self->lower_slots[k] = fill[self->up_ends[k]] ++;
+        }
+        free(fill);
 
         self->x_scale = sqrtf(self->num_verts)*c_MetersPerParticle;
         self->y_scale = sqrtf(self->num_verts)*c_MetersPerParticle;
@@ -111,20 +189,24 @@ static struct bio_graph* __data_get_graph(struct display_data* self)
         return self->graph;
 }
 
+// uniform grid over the bounding box of the vertices. the vertices are bucketed by
+// cell with a counting sort, so every cell is a contiguous range of one index array.
 struct display_cell {
-        struct display_vertex*  verts;
+        int                     first;
         int                     num_verts;
         float                   centroid_x;
         float                   centroid_y;
-        int                     id_marker;
 };
-/*
-#define c_Grid_X_Span           4
-#define c_Grid_Y_Span           4
-*/
+
 struct display_grid {
         struct display_cell*    cells;          // grid subdivide approximation
-        struct display_cell**   tmp;
+        int*                    occupied;       // cells with at least one vertex
+        int                     num_occupied;
+        int*                    indices;        // vertex ids ordered by cell
+        float*                  sorted_x;       // positions in the order of indices
+        float*                  sorted_y;
+        int*                    vert_cells;     // cell of each vertex
+        int                     num_verts;
         int                     n_grid_x;
         int                     n_grid_y;
 
@@ -137,131 +219,357 @@ struct display_grid {
 };
 
 
-static void __grid_init(struct display_grid* self, int nx, int ny)
+static void __grid_init(struct display_grid* self, int nx, int ny, int num_verts)
 {
         memset(self, 0, sizeof(*self));
-        self->n_grid_x = nx;
-        self->n_grid_y = ny;
-        self->cells = malloc(sizeof(struct display_cell)*self->n_grid_x*self->n_grid_y);
-        self->tmp   = malloc(sizeof(struct display_cell*)*self->n_grid_x*self->n_grid_y);
-        int i, j;
-        for (i = 0; i < self->n_grid_y; i ++) {
-                for (j = 0; j < self->n_grid_x; j ++) {
-                        self->cells[j + i*self->n_grid_x].verts = nullptr;
-                }
-        }
+        self->n_grid_x  = MAX(1, nx);
+        self->n_grid_y  = MAX(1, ny);
+        self->num_verts = num_verts;
+        self->cells     = malloc(sizeof(*self->cells)*self->n_grid_x*self->n_grid_y);
+        self->occupied  = malloc(sizeof(*self->occupied)*self->n_grid_x*self->n_grid_y);
+        self->indices   = malloc(sizeof(*self->indices)*MAX(1, num_verts));
+        self->sorted_x  = malloc(sizeof(*self->sorted_x)*MAX(1, num_verts));
+        self->sorted_y  = malloc(sizeof(*self->sorted_y)*MAX(1, num_verts));
+        self->vert_cells = malloc(sizeof(*self->vert_cells)*MAX(1, num_verts));
 }
 
 static void __grid_free(struct display_grid* self)
 {
-        if (self->cells) {
-                int i, j;
-                for (i = 0; i < self->n_grid_y; i ++) {
-                        for (j = 0; j < self->n_grid_x; j ++) {
-                                free(self->cells[j + i*self->n_grid_x].verts);
-                        }
+        free(self->cells);
+        free(self->occupied);
+        free(self->indices);
+        free(self->sorted_x);
+        free(self->sorted_y);
+        free(self->vert_cells);
+        memset(self, 0, sizeof(*self));
+}
+
+static int __grid_which_cell(const struct display_grid* self, float x_pos, float y_pos)
+{
+        // the max_x/max_y edges belong to the last row and column
+        int i = CLAMP((int)((x_pos - self->min_x)*self->interp_x), 0, self->n_grid_x - 1);
+        int j = CLAMP((int)((y_pos - self->min_y)*self->interp_y), 0, self->n_grid_y - 1);
+        return i + j*self->n_grid_x;
+}
+
+static void __grid_update_with_vertex(struct display_grid* self, struct display_data* data)
+{
+        // initialize grid setup
+        __data_find_system_scale(data, &self->min_x, &self->min_y, &self->max_x, &self->max_y);
+        self->interp_x = self->max_x > self->min_x ? self->n_grid_x/(self->max_x - self->min_x) : 0.0f;
+        self->interp_y = self->max_y > self->min_y ? self->n_grid_y/(self->max_y - self->min_y) : 0.0f;
+
+        int num_cells = self->n_grid_x*self->n_grid_y;
+        int p;
+        for (p = 0; p < num_cells; p ++) {
+                self->cells[p].num_verts = 0;
+                self->cells[p].centroid_x = 0.0f;
+                self->cells[p].centroid_y = 0.0f;
+        }
+        // count the vertices of each cell and sum up their positions
+        const float* pos_x = data->pos_x;
+        const float* pos_y = data->pos_y;
+        int i;
+        for (i = 0; i < self->num_verts; i ++) {
+                p = __grid_which_cell(self, pos_x[i], pos_y[i]);
+                self->vert_cells[i] = p;
+                self->cells[p].num_verts ++;
+                self->cells[p].centroid_x += pos_x[i];
+                self->cells[p].centroid_y += pos_y[i];
+        }
+        int first = 0;
+        self->num_occupied = 0;
+        for (p = 0; p < num_cells; p ++) {
+                struct display_cell* cell = &self->cells[p];
+                cell->first = first;
+                first += cell->num_verts;
+                if (cell->num_verts != 0) {
+                        cell->centroid_x /= cell->num_verts;
+                        cell->centroid_y /= cell->num_verts;
+                        self->occupied[self->num_occupied ++] = p;
                 }
-                free(self->cells);
+                cell->num_verts = 0;
         }
-        if (self->tmp) {
-                free(self->tmp);
+        // scatter the vertex ids, num_verts is counted up again on the way
+        for (i = 0; i < self->num_verts; i ++) {
+                struct display_cell* cell = &self->cells[self->vert_cells[i]];
+                int k = cell->first + cell->num_verts ++;
+                self->indices[k] = i;
+                self->sorted_x[k] = pos_x[i];
+                self->sorted_y[k] = pos_y[i];
         }
+}
+
+// barnes-hut quadtree. vertices are reordered in an index array so that every node
+// covers a contiguous range of it, children are only created for non-empty quadrants.
+struct display_quad_node {
+        float                   centroid_x;
+        float                   centroid_y;
+        float                   mass;           // number of vertices below the node
+        float                   min_x;          // tight bounds of those vertices
+        float                   min_y;
+        float                   max_x;
+        float                   max_y;
+        int                     first;
+        int                     count;
+        int                     children[4];    // -1 when the quadrant is empty, all -1 for leaves
+};
+
+#define c_QuadLeafSize          16      // one avx-512 vector of positions
+#define c_QuadMaxDepth          32
+#define c_DefaultQuadTheta      0.7f
+
+struct display_quad {
+        struct display_quad_node*       nodes;
+        int                             num_nodes;
+        int                             capacity;
+        int*                            indices;
+        float*                          sorted_x;       // positions in the order of indices
+        float*                          sorted_y;
+        int                             num_verts;
+        float                           theta;
+};
+
+static void __quad_init(struct display_quad* self, float theta)
+{
         memset(self, 0, sizeof(*self));
+        self->theta = theta;
 }
 
-static void __grid_reserve_vertex_count(struct display_grid* self, int num_verts)
+static void __quad_free(struct display_quad* self)
 {
-        int i, j;
-        for (i = 0; i < self->n_grid_y; i ++) {
-                for (j = 0; j < self->n_grid_x; j ++) {
-                        int p = j + i*self->n_grid_x;
-                        if (self->cells[p].verts) {
-                                free(self->cells[p].verts);
-                        }
-                        self->cells[p].verts = malloc(sizeof(struct display_vertex)*num_verts);
-                }
-        }
+        free(self->nodes);
+        free(self->indices);
+        free(self->sorted_x);
+        free(self->sorted_y);
+        memset(self, 0, sizeof(*self));
 }
 
-static struct display_cell* __grid_which_cell(struct display_grid* self, float x_pos, float y_pos)
+static int __quad_new_node(struct display_quad* self, int first, int count)
 {
-        int i = (int)((x_pos - self->min_x)*self->interp_x);
-        int j = (int)((y_pos - self->min_y)*self->interp_y);
-        return &self->cells[i + j*self->n_grid_x];
+        if (self->num_nodes == self->capacity) {
+                self->capacity = MAX(64, self->capacity*2);
+                self->nodes = realloc(self->nodes, sizeof(*self->nodes)*self->capacity);
+        }
+        struct display_quad_node* node = &self->nodes[self->num_nodes];
+        node->first     = first;
+        node->count     = count;
+        node->children[0] = node->children[1] = node->children[2] = node->children[3] = -1;
+        return self->num_nodes ++;
 }
 
-static struct display_cell** __grid_which_cells_within_radius(struct display_grid* self,
-                                                             float x_pos, float y_pos, float radius, int* num_cells)
+// mass, centroid and bounds of a leaf from its vertices
+static void __quad_fit_leaf(struct display_quad_node* node, const int* indices, const float* pos_x, const float* pos_y)
 {
-        int s_x = (int) ((x_pos - radius - self->min_x)*self->interp_x);
-        int s_y = (int) ((y_pos - radius - self->min_y)*self->interp_y);
-        int e_x = (int) ((x_pos + radius - self->min_x)*self->interp_x);
-        int e_y = (int) ((y_pos + radius - self->min_y)*self->interp_y);
+        float sum_x = 0.0f, sum_y = 0.0f;
+        node->min_x = node->min_y = FLT_MAX;
+        node->max_x = node->max_y = -FLT_MAX;
+        int i;
+        for (i = node->first; i < node->first + node->count; i ++) {
+                float x = pos_x[indices[i]];
+                float y = pos_y[indices[i]];
+                sum_x += x;
+                sum_y += y;
+                node->min_x = MIN(node->min_x, x);
+                node->min_y = MIN(node->min_y, y);
+                node->max_x = MAX(node->max_x, x);
+                node->max_y = MAX(node->max_y, y);
+        }
+        node->mass       = node->count;
+        node->centroid_x = sum_x/node->count;
+        node->centroid_y = sum_y/node->count;
+}
 
-        s_x = MAX(s_x, 0);
-        s_y = MAX(s_y, 0);
-        e_x = MIN(e_x, self->n_grid_x - 1);
-        e_y = MIN(e_y, self->n_grid_y - 1);
+// moves the indices whose vertex lies below the split to the front, returns how many there are
+static int __quad_partition(int* indices, int count, const float* pos, float split)
+{
+        int i = 0, j = count - 1;
+        while (i <= j) {
+                if (pos[indices[i]] < split) {
+                        i ++;
+                } else {
+                        int t = indices[i];
+                        indices[i] = indices[j];
+                        indices[j --] = t;
+                }
+        }
+        return i;
+}
 
-        int n_cells = 0;
-        int k, l;
-        float r2 = radius*radius;
-        for (k = s_y; k <= e_y; k ++) {
-                for (l = s_x; l <= e_x; l ++) {
-                        int p = l + k*self->n_grid_x;
-                        float vx = self->cells[p].centroid_x - x_pos;
-                        float vy = self->cells[p].centroid_y - y_pos;
-                        if (vx*vx + vy*vy < r2) {
-                                self->tmp[n_cells ++] = &self->cells[p];
-                        }
+static int __quad_build_node(struct display_quad* self, const float* pos_x, const float* pos_y, int first, int count, int depth)
+{
+        int n = __quad_new_node(self, first, count);
+        __quad_fit_leaf(&self->nodes[n], self->indices, pos_x, pos_y);
+        struct display_quad_node* node = &self->nodes[n];
+        float w = node->max_x - node->min_x;
+        float h = node->max_y - node->min_y;
+        if (count <= c_QuadLeafSize || depth >= c_QuadMaxDepth || (w <= 0.0f && h <= 0.0f)) {
+                return n;
+        }
+        float split_x = node->min_x + 0.5f*w;
+        float split_y = node->min_y + 0.5f*h;
+        int* indices = &self->indices[first];
+        int n_low = __quad_partition(indices, count, pos_y, split_y);
+        int n_low_left = __quad_partition(indices, n_low, pos_x, split_x);
+        int n_high_left = __quad_partition(&indices[n_low], count - n_low, pos_x, split_x);
+        int starts[4] = {0, n_low_left, n_low, n_low + n_high_left};
+        int counts[4] = {n_low_left, n_low - n_low_left, n_high_left, count - n_low - n_high_left};
+        int c;
+        for (c = 0; c < 4; c ++) {
+                if (counts[c] > 0) {
+                        // the node array may move while the child is built
+                        int child = __quad_build_node(self, pos_x, pos_y, first + starts[c], counts[c], depth + 1);
+                        self->nodes[n].children[c] = child;
                 }
         }
+        return n;
+}
 
-        *num_cells = n_cells;
-        return self->tmp;
+// copies the positions into the order of the leaves, so leaves are contiguous ranges for the kernels
+static void __quad_sort_positions(struct display_quad* self, const float* pos_x, const float* pos_y)
+{
+        int i;
+        for (i = 0; i < self->num_verts; i ++) {
+                self->sorted_x[i] = pos_x[self->indices[i]];
+                self->sorted_y[i] = pos_y[self->indices[i]];
+        }
 }
 
-static void __grid_update_with_vertex(struct display_grid* self, struct display_data* data)
+static void __quad_build(struct display_quad* self, const float* pos_x, const float* pos_y, int num_verts)
 {
-        // initialize grid setup
-        __data_find_system_scale(data, &self->min_x, &self->min_y, &self->max_x, &self->max_y);
-        self->interp_x = (self->n_grid_x - 1)/(self->max_x - self->min_x);
-        self->interp_y = (self->n_grid_y - 1)/(self->max_y - self->min_y);
+        if (self->num_verts != num_verts) {
+                free(self->indices);
+                free(self->sorted_x);
+                free(self->sorted_y);
+                self->indices = malloc(sizeof(*self->indices)*MAX(1, num_verts));
+                self->sorted_x = malloc(sizeof(*self->sorted_x)*MAX(1, num_verts));
+                self->sorted_y = malloc(sizeof(*self->sorted_y)*MAX(1, num_verts));
+                self->num_verts = num_verts;
+        }
+        int i;
+        for (i = 0; i < num_verts; i ++) {
+                self->indices[i] = i;
+        }
+        self->num_nodes = 0;
+        if (num_verts > 0) {
+                __quad_build_node(self, pos_x, pos_y, 0, num_verts, 0);
+        }
+        __quad_sort_positions(self, pos_x, pos_y);
+}
 
-        int i, j;
-        for (i = 0; i < self->n_grid_y; i ++) {
-                for (j = 0; j < self->n_grid_x; j ++) {
-                        int p = j + i*self->n_grid_x;
-                        self->cells[p].num_verts = 0;
-                        self->cells[p].centroid_x = 0.0f;
-                        self->cells[p].centroid_y = 0.0f;
-                        self->cells[p].id_marker = -1;
+// fade keeps the quadtree topology across steps: in between rebuilds the nodes are only
+// refit to the moved vertices. repulsion is evaluated between pairs of well separated
+// nodes (cluster to cluster), the per node accelerations are pushed down to the vertices.
+#define c_FadeRebuildSteps      10
+#define c_FadeMaxLeafGrowth     1.5f
+
+struct display_fade {
+        struct display_quad     tree;
+        float*                  node_acc_x;     // node_capacity entries per slot
+        float*                  node_acc_y;
+        int                     node_capacity;
+        int*                    pairs;          // node pairs the slots work through
+        int                     num_pairs;
+        int                     pair_capacity;
+        int                     num_slots;
+        int                     steps_since_build;
+        float                   built_leaf_extent;      // summed leaf extents right after the last build
+};
+
+static void __fade_init(struct display_fade* self, float theta)
+{
+        memset(self, 0, sizeof(*self));
+        __quad_init(&self->tree, theta);
+}
+
+static void __fade_free(struct display_fade* self)
+{
+        __quad_free(&self->tree);
+        free(self->node_acc_x);
+        free(self->node_acc_y);
+        free(self->pairs);
+        memset(self, 0, sizeof(*self));
+}
+
+static bool __quad_is_leaf(const struct display_quad_node* node)
+{
+        return node->children[0] == -1 && node->children[1] == -1 &&
+               node->children[2] == -1 && node->children[3] == -1;
+}
+
+// children are created after their parent, so walking the nodes backwards refits bottom-up
+static void __quad_refit(struct display_quad* self, const float* pos_x, const float* pos_y)
+{
+        int n;
+        for (n = self->num_nodes - 1; n >= 0; n --) {
+                struct display_quad_node* node = &self->nodes[n];
+                if (__quad_is_leaf(node)) {
+                        __quad_fit_leaf(node, self->indices, pos_x, pos_y);
+                        continue;
                 }
-        }
-        // put vertex in cell and calculate the centroid of each cell
-        struct display_vertex* verts = __data_get_vertices(data);
-        for (i = 0; i < __data_get_vertex_num(data); i ++) {
-                struct display_cell* cell = __grid_which_cell(self, verts[i].pos_x, verts[i].pos_y);
-                cell->verts[cell->num_verts ++] = verts[i];
-                cell->centroid_x += verts[i].pos_x;
-                cell->centroid_y += verts[j].pos_y;
-        }
-        for (i = 0; i < self->n_grid_y; i ++) {
-                for (j = 0; j < self->n_grid_x; j ++) {
-                        int p = j + i*self->n_grid_x;
-                        if (self->cells[p].num_verts != 0) {
-                                self->cells[p].centroid_x /= self->cells[p].num_verts;
-                                self->cells[p].centroid_y /= self->cells[p].num_verts;
+                float sum_x = 0.0f, sum_y = 0.0f;
+                node->min_x = node->min_y = FLT_MAX;
+                node->max_x = node->max_y = -FLT_MAX;
+                int c;
+                for (c = 0; c < 4; c ++) {
+                        if (node->children[c] == -1) {
+                                continue;
                         }
+                        const struct display_quad_node* child = &self->nodes[node->children[c]];
+                        sum_x += child->centroid_x*child->mass;
+                        sum_y += child->centroid_y*child->mass;
+                        node->min_x = MIN(node->min_x, child->min_x);
+                        node->min_y = MIN(node->min_y, child->min_y);
+                        node->max_x = MAX(node->max_x, child->max_x);
+                        node->max_y = MAX(node->max_y, child->max_y);
                 }
+                node->centroid_x = sum_x/node->mass;
+                node->centroid_y = sum_y/node->mass;
         }
+        __quad_sort_positions(self, pos_x, pos_y);
 }
 
-struct display_quad {
-};
+static float __quad_leaf_extent(const struct display_quad* self)
+{
+        float sum = 0.0f;
+        int n;
+        for (n = 0; n < self->num_nodes; n ++) {
+                const struct display_quad_node* node = &self->nodes[n];
+                if (__quad_is_leaf(node)) {
+                        sum += MAX(node->max_x - node->min_x, node->max_y - node->min_y);
+                }
+        }
+        return sum;
+}
 
-struct display_fade {
-};
+static void __fade_update(struct display_fade* self, const float* pos_x, const float* pos_y, int num_verts, int num_slots)
+{
+        bool rebuild = self->tree.num_nodes == 0 || self->tree.num_verts != num_verts ||
+                       self->steps_since_build >= c_FadeRebuildSteps;
+        if (!rebuild) {
+                // leaves that spread out make the cluster approximations useless, start over then
+                __quad_refit(&self->tree, pos_x, pos_y);
+                rebuild = __quad_leaf_extent(&self->tree) > c_FadeMaxLeafGrowth*self->built_leaf_extent;
+        }
+        if (rebuild) {
+                __quad_build(&self->tree, pos_x, pos_y, num_verts);
+                self->built_leaf_extent = __quad_leaf_extent(&self->tree);
+                self->steps_since_build = 0;
+        }
+        self->steps_since_build ++;
+        if (self->node_capacity < self->tree.num_nodes || self->num_slots != num_slots) {
+                self->node_capacity = self->tree.capacity;
+                self->num_slots = num_slots;
+                free(self->node_acc_x);
+                free(self->node_acc_y);
+                self->node_acc_x = calloc(self->node_capacity*num_slots, sizeof(*self->node_acc_x));
+                self->node_acc_y = calloc(self->node_capacity*num_slots, sizeof(*self->node_acc_y));
+        }
+}
+
+#define c_DefaultMaxSteps       2000
+#define c_DefaultTolerance      1e-5f
+#define c_DefaultSeed           1
 
 struct graph_display {
         void*                   buffer;
@@ -274,6 +582,39 @@ struct graph_display {
 
         bool                    use_grid;
         struct display_grid     grid;
+
+        bool                    use_quad;
+        struct display_quad     quad;
+
+        bool                    use_fade;
+        struct display_fade     fade;
+
+        bool                    use_multilevel;
+
+        struct parallel_pool*   pool;
+        int                     num_threads;    // threads the kernels of the current graph run on
+        int                     num_slots;      // fade slots, fixed by the graph size and not by the threads
+        float*                  slot_acc;       // one buffer per fade slot, 2 floats per vertex
+        f_Repulsion_Kernel      repulse;        // widest vector kernel the processor runs
+        int                     next_chunk;     // work counter of the running kernel
+
+        int                     max_steps;
+        float                   tolerance;
+        float                   step;           // adaptive cooling state
+        float                   max_step;
+        float                   energy;
+        int                     progress;
+        float*                  energies;       // energy curve of the current level
+        int                     energy_capacity;
+        struct graph_display_stats      stats;
+
+        uint64_t                seed;
+        uint64_t                random;         // generator state, reset to the seed by every layout run
+
+        float*                  initial_x;      // warm start positions, nullptr for a cold start
+        float*                  initial_y;
+        bool*                   initial_placed;
+        int                     initial_num;
 };
 
 struct graph_display* graph_display_create(enum AccelerateMethod acc)
@@ -284,11 +625,19 @@ struct graph_display* graph_display_create(enum AccelerateMethod acc)
         self->height    = 600;
 #ifdef USE_GTK
         self->stride    = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, self->width);
+#else
+        self->stride    = self->width*4;
 #endif
         self->ps        = self->stride/self->width;
         self->buffer    = malloc(self->stride*self->height);
 
         __data_init(&self->data);
+        self->repulse   = graph_display_kernel_select();
+        self->max_steps = c_DefaultMaxSteps;
+        self->tolerance = c_DefaultTolerance;
+        self->seed      = c_DefaultSeed;
+        __quad_init(&self->quad, c_DefaultQuadTheta);
+        __fade_init(&self->fade, c_DefaultQuadTheta);
 
         switch(acc) {
         case AccelerateMethodNone:
@@ -296,14 +645,17 @@ struct graph_display* graph_display_create(enum AccelerateMethod acc)
         case AccelerateMethodGrid:
                 self->use_grid  = true;
                 break;
+        case AccelerateMethodFADE:
+                self->use_fade  = true;
+                break;
+        case AccelerateMethodBarnesHut:
+                self->use_quad  = true;
+                break;
         default:
                 printf("accelerating structure %d is not supported\n", acc);
                 break;
         }
 
-        if (self->use_grid) {
-                // self->grid = __grid_create();
-        }
         return self;
 }
 
@@ -317,10 +669,75 @@ void graph_display_free(struct graph_display* self)
         if (self->use_grid) {
                 __grid_free(&self->grid);
         }
+        __quad_free(&self->quad);
+        __fade_free(&self->fade);
+        parallel_pool_free(self->pool);
+        free(self->slot_acc);
+        free(self->energies);
+        free(self->initial_x);
+        free(self->initial_y);
+        free(self->initial_placed);
         memset(self, 0, sizeof(*self));
         free(self);
 }
 
+void graph_display_set_theta(struct graph_display* self, float theta)
+{
+        // opening angle of the barnes-hut and fade approximations, 0 is exact
+        self->quad.theta = MAX(0.0f, theta);
+        self->fade.tree.theta = MAX(0.0f, theta);
+}
+
+void graph_display_set_multilevel(struct graph_display* self, bool use_multilevel)
+{
+        self->use_multilevel = use_multilevel;
+}
+
+void graph_display_set_tolerance(struct graph_display* self, float tolerance)
+{
+        // mean displacement per step, relative to the layout scale, below which the layout is done
+        self->tolerance = MAX(0.0f, tolerance);
+}
+
+const struct graph_display_stats* graph_display_get_stats(const struct graph_display* self)
+{
+        return &self->stats;
+}
+
+void graph_display_set_seed(struct graph_display* self, uint64_t seed)
+{
+        self->seed = seed;
+}
+
+void graph_display_set_initial_layout(struct graph_display* self, const float* pos_x, const float* pos_y,
+                                      const bool* placed, int num_verts)
+{
+        free(self->initial_x);
+        free(self->initial_y);
+        free(self->initial_placed);
+        self->initial_x         = nullptr;
+        self->initial_y         = nullptr;
+        self->initial_placed    = nullptr;
+        self->initial_num       = 0;
+        if (pos_x == nullptr) {
+                return ;
+        }
+        self->initial_x         = malloc(sizeof(*self->initial_x)*MAX(1, num_verts));
+        self->initial_y         = malloc(sizeof(*self->initial_y)*MAX(1, num_verts));
+        self->initial_placed    = malloc(sizeof(*self->initial_placed)*MAX(1, num_verts));
+        self->initial_num       = num_verts;
+        memcpy(self->initial_x, pos_x, sizeof(*pos_x)*num_verts);
+        memcpy(self->initial_y, pos_y, sizeof(*pos_y)*num_verts);
+        memcpy(self->initial_placed, placed, sizeof(*placed)*num_verts);
+}
+
+void graph_display_get_layout(const struct graph_display* self, const float** pos_x, const float** pos_y, int* num_verts)
+{
+        *pos_x = self->data.pos_x;
+        *pos_y = self->data.pos_y;
+        *num_verts = self->data.num_verts;
+}
+
 void graph_display_set_dimension(struct graph_display* self, int width, int height)
 {
         free(self->buffer);
@@ -334,6 +751,8 @@ void graph_display_set_dimension(struct graph_display* self, int width, int heig
         }
 #ifdef USE_GTK
         self->stride    = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, self->width);
+#else
+        self->stride    = self->width*4;
 #endif // USE_GTK
         self->ps        = self->stride/self->width;
         self->buffer    = malloc(self->stride*self->height);
@@ -344,101 +763,445 @@ static const float      c_c2 = 1.0f;
 static const float      c_c3 = 1.0f;
 static const float      c_c4 = 0.01f;
 
-static void __edge_string_acceleration(const struct bio_graph_vertex* v0, const struct bio_graph_vertex* v1, void* user_data)
+// a step is split into kernels that run on the thread pool. springs and repulsion are gathered per
+// vertex (the springs after a pass that evaluates every edge once), each thread only writes the
+// vertices it took, so no kernel needs atomics or locks on the vertex data. fade scatters into both
+// ends of a node pair instead: its pairs are dealt to a fixed number of slots with a buffer each,
+// the threads take whole slots and the buffers are summed in slot order. every sum is then taken
+// in the same order whatever the number of threads, a seed gives the same layout bit for bit.
+#define c_MinParallelVerts      1024
+#define c_VertexChunk           64
+#define c_FadeSlots             16
+
+static float* __slot_acc(struct graph_display* self, int slot)
 {
-        // struct graph_display* self = user_data;
+        return &self->slot_acc[2*__data_get_vertex_num(&self->data)*slot];
+}
 
-        struct display_vertex* dv0 = bio_graph_vertex_retrieve_data(v0);
-        struct display_vertex* dv1 = bio_graph_vertex_retrieve_data(v1);
-        dv0->mass = bio_graph_vertex_get_degree(v0);
-        dv1->mass = bio_graph_vertex_get_degree(v1);
+// takes the next chunk of vertices for the calling thread, false when they are all taken
+static bool __next_vertex_chunk(struct graph_display* self, int* first, int* last)
+{
+        int n = __data_get_vertex_num(&self->data);
+        *first = __atomic_fetch_add(&self->next_chunk, c_VertexChunk, __ATOMIC_RELAXED);
+        *last = MIN(n, *first + c_VertexChunk);
+        return *first < n;
+}
 
-        float vx = dv1->pos_x - dv0->pos_x;
-        float vy = dv1->pos_y - dv0->pos_y;
-        float dist2 = vx*vx + vy*vy;
-        float dist = sqrtf(dist2);
-        if (dist2 < 1e-3) {
-                dist = 1e-3;
+// the spring of every edge that runs up from v, it pulls both ends towards each other
+static inline void __vertex_string_force(struct display_data* data, int v)
+{
+        float x0 = data->pos_x[v];
+        float y0 = data->pos_y[v];
+        int k;
+        for (k = data->up_offsets[v]; k < data->up_offsets[v + 1]; k ++) {
+                int w = data->up_ends[k];
+                float vx = data->pos_x[w] - x0;
+                float vy = data->pos_y[w] - y0;
+                float dist2 = vx*vx + vy*vy;
+                float dist = sqrtf(dist2);
+                if (dist2 < 1e-3f) {
+                        dist = 1e-3f;
+                }
+                // one scalar divide, gcc otherwise pairs the two into a packed divide with garbage upper lanes
+                float f_spring = c_c1*logf(dist/c_c2)/dist;
+                int l = data->lower_slots[k];
+                data->up_springs[2*k + 0] = vx*f_spring;
+                data->up_springs[2*k + 1] = vy*f_spring;
+                data->lower_springs[2*l + 0] = vx*f_spring;
+                data->lower_springs[2*l + 1] = vy*f_spring;
+        }
+}
+
+static void __spring_task(int thread_id, int num_threads, void* user_data)
+{
+        struct graph_display* self = user_data;
+        int first, last, v;
+        while (__next_vertex_chunk(self, &first, &last)) {
+                for (v = first; v < last; v ++) {
+                        __vertex_string_force(&self->data, v);
+                }
         }
-        float f_spring = c_c1*log(dist/c_c2);
-        vx /= dist;
-        vy /= dist;
-        dv0->acc_x += vx*f_spring;
-        dv0->acc_y += vy*f_spring;
 }
 
-static void __calc_electrical_acc(struct display_vertex* v0, struct display_vertex* v1_list, int num_v1, float scale_xy)
+// sums the springs of v, the edges that run up first and then those that come from below
+static void __spring_gather_task(int thread_id, int num_threads, void* user_data)
 {
-        struct display_vertex* dv0 = v0;
+        struct graph_display* self = user_data;
+        struct display_data* data = &self->data;
+        int first, last, v, k;
+        while (__next_vertex_chunk(self, &first, &last)) {
+                for (v = first; v < last; v ++) {
+                        float acc_x = 0.0f, acc_y = 0.0f;
+                        for (k = data->up_offsets[v]; k < data->up_offsets[v + 1]; k ++) {
+                                acc_x += data->up_springs[2*k + 0];
+                                acc_y += data->up_springs[2*k + 1];
+                        }
+                        for (k = data->lower_offsets[v]; k < data->lower_offsets[v + 1]; k ++) {
+                                acc_x -= data->lower_springs[2*k + 0];
+                                acc_y -= data->lower_springs[2*k + 1];
+                        }
+                        data->acc_x[v] += acc_x;
+                        data->acc_y[v] += acc_y;
+                }
+        }
+}
 
-        int i;
-        for (i = 0; i < num_v1; i ++) {
-                struct display_vertex* dv1 = &v1_list[i];
-                if (dv0 == dv1) continue;
-                float vx = dv1->pos_x - dv0->pos_x;
-                float vy = dv1->pos_y - dv0->pos_y;
+// adds the fade slot buffers up into the vertices, in slot order, and clears them for the next step
+static void __reduce_task(int thread_id, int num_threads, void* user_data)
+{
+        struct graph_display* self = user_data;
+        struct display_data* data = &self->data;
+        int n = __data_get_vertex_num(data);
+        int v, s;
+        for (v = (long) n*thread_id/num_threads; v < (long) n*(thread_id + 1)/num_threads; v ++) {
+                for (s = 0; s < self->num_slots; s ++) {
+                        float* acc = __slot_acc(self, s);
+                        data->acc_x[v] += acc[2*v + 0];
+                        data->acc_y[v] += acc[2*v + 1];
+                        acc[2*v + 0] = 0.0f;
+                        acc[2*v + 1] = 0.0f;
+                }
+        }
+}
+
+// near field terms go through the vectorized kernel over contiguous position ranges, far field
+// terms against cluster centroids are few and stay scalar
+static void __vertex_electrical_acceleration(struct graph_display* self, int v, float* acc)
+{
+        const struct display_data* data = &self->data;
+        float x_scale, y_scale;
+        __data_get_scale(&self->data, &x_scale, &y_scale);
+        float max_force = (x_scale + y_scale)*0.5f/10.0f;
+        self->repulse(data->pos_x[v], data->pos_y[v], data->pos_x, data->pos_y, data->num_verts, c_c3, max_force, acc);
+}
+
+static void __vertex_electrical_acceleration_with_grid(struct graph_display* self, int v, float* acc)
+{
+        const struct display_grid* grid = &self->grid;
+        float x0 = self->data.pos_x[v];
+        float y0 = self->data.pos_y[v];
+        float x_scale, y_scale;
+        __data_get_scale(&self->data, &x_scale, &y_scale);
+        float max_force = (x_scale + y_scale)*0.5f/10.0f;
+        int home = grid->vert_cells[v];
+        int home_x = home%grid->n_grid_x;
+        int home_y = home/grid->n_grid_x;
+        // the 3x3 neighbourhood is summed exactly, the three cells of a row are adjacent in the sorted order
+        int row;
+        for (row = MAX(0, home_y - 1); row <= MIN(grid->n_grid_y - 1, home_y + 1); row ++) {
+                const struct display_cell* lo = &grid->cells[row*grid->n_grid_x + MAX(0, home_x - 1)];
+                const struct display_cell* hi = &grid->cells[row*grid->n_grid_x + MIN(grid->n_grid_x - 1, home_x + 1)];
+                self->repulse(x0, y0, &grid->sorted_x[lo->first], &grid->sorted_y[lo->first],
+                              hi->first + hi->num_verts - lo->first, c_c3, max_force, acc);
+        }
+        int k;
+        for (k = 0; k < grid->num_occupied; k ++) {
+                int p = grid->occupied[k];
+                const struct display_cell* cell = &grid->cells[p];
+                if (abs(p%grid->n_grid_x - home_x) <= 1 && abs(p/grid->n_grid_x - home_y) <= 1) {
+                        continue;
+                }
+                // cells further away act as one particle at their centroid
+                float mass = cell->num_verts;
+                float vx = cell->centroid_x - x0;
+                float vy = cell->centroid_y - y0;
                 float dist2 = vx*vx + vy*vy;
                 float dist = sqrtf(dist2);
                 if (dist2 < 1e-3) {
-                        dist = 1e-3;
-                        dist2 = dist*dist;
+                        continue;
                 }
-                float f_electron = CLAMP(-c_c3/dist2, -scale_xy/10.0f, 0.0f);
-                vx /= dist;
-                vy /= dist;
-                dv0->acc_x += vx*f_electron;
-                dv0->acc_y += vy*f_electron;
+                float f_electron = CLAMP(-mass*c_c3/dist2, -max_force, 0.0f);
+                acc[0] += vx/dist*f_electron;
+                acc[1] += vy/dist*f_electron;
         }
 }
-static void __vertex_electrical_acceleration(const struct bio_graph_vertex* v, void* user_data)
+
+static void __vertex_electrical_acceleration_with_quad(struct graph_display* self, int v, float* acc)
 {
-        struct graph_display* self = user_data;
+        const struct display_quad* quad = &self->quad;
+        if (quad->num_nodes == 0) {
+                return ;
+        }
+        float x0 = self->data.pos_x[v];
+        float y0 = self->data.pos_y[v];
         float x_scale, y_scale;
         __data_get_scale(&self->data, &x_scale, &y_scale);
-        __calc_electrical_acc(bio_graph_vertex_retrieve_data(v),
-                              __data_get_vertices(&self->data), __data_get_vertex_num(&self->data),
-                              (x_scale + y_scale)*0.5f);
+        float max_force = (x_scale + y_scale)*0.5f/10.0f;
+        float theta2 = quad->theta*quad->theta;
+
+        int stack[4*c_QuadMaxDepth + 4];
+        int top = 0;
+        stack[top ++] = 0;
+        while (top > 0) {
+                const struct display_quad_node* node = &quad->nodes[stack[-- top]];
+                float vx = node->centroid_x - x0;
+                float vy = node->centroid_y - y0;
+                float dist2 = vx*vx + vy*vy;
+                float extent = MAX(node->max_x - node->min_x, node->max_y - node->min_y);
+                if (__quad_is_leaf(node)) {
+                        // leaf: exact interaction with each vertex in it
+                        self->repulse(x0, y0, &quad->sorted_x[node->first], &quad->sorted_y[node->first],
+                                      node->count, c_c3, max_force, acc);
+                } else if (extent*extent < theta2*dist2) {
+                        // far enough: the whole node acts as one particle at its centroid
+                        float dist = sqrtf(dist2);
+                        float f_electron = CLAMP(-node->mass*c_c3/dist2, -max_force, 0.0f);
+                        acc[0] += vx/dist*f_electron;
+                        acc[1] += vy/dist*f_electron;
+                } else {
+                        int c;
+                        for (c = 0; c < 4; c ++) {
+                                if (node->children[c] != -1) {
+                                        stack[top ++] = node->children[c];
+                                }
+                        }
+                }
+        }
+}
+
+static void __repulsion_task(int thread_id, int num_threads, void* user_data)
+{
+        struct graph_display* self = user_data;
+        struct display_data* data = &self->data;
+        int first, last, v;
+        while (__next_vertex_chunk(self, &first, &last)) {
+                for (v = first; v < last; v ++) {
+                        float acc[2] = {0.0f, 0.0f};
+                        if (self->use_grid) {
+                                __vertex_electrical_acceleration_with_grid(self, v, acc);
+                        } else if (self->use_quad) {
+                                __vertex_electrical_acceleration_with_quad(self, v, acc);
+                        } else {
+                                __vertex_electrical_acceleration(self, v, acc);
+                        }
+                        data->acc_x[v] += acc[0];
+                        data->acc_y[v] += acc[1];
+                }
+        }
+}
+
+// the accumulators of the slot a thread works through
+struct fade_acc {
+        float*                  node_acc_x;
+        float*                  node_acc_y;
+        float*                  vert_acc;       // 2 floats per vertex
+};
+
+static bool __fade_separated(const struct display_quad* tree, const struct display_quad_node* na, const struct display_quad_node* nb)
+{
+        float vx = nb->centroid_x - na->centroid_x;
+        float vy = nb->centroid_y - na->centroid_y;
+        float dist2 = vx*vx + vy*vy;
+        float extent = MAX(MAX(na->max_x - na->min_x, na->max_y - na->min_y),
+                           MAX(nb->max_x - nb->min_x, nb->max_y - nb->min_y));
+        return extent*extent < tree->theta*tree->theta*dist2 && dist2 >= 1e-3;
+}
+
+// true when the pair a, b is resolved by opening a rather than b
+static bool __fade_opens_a(const struct display_quad_node* na, const struct display_quad_node* nb)
+{
+        float extent_a = MAX(na->max_x - na->min_x, na->max_y - na->min_y);
+        float extent_b = MAX(nb->max_x - nb->min_x, nb->max_y - nb->min_y);
+        return __quad_is_leaf(nb) || (!__quad_is_leaf(na) && extent_a >= extent_b);
+}
+
+// every vertex of leaf a against all vertices of leaf b, a vertex of a that is also in b adds nothing for itself
+static void __fade_leaf_to_leaf(struct graph_display* self, const struct display_quad_node* na, const struct display_quad_node* nb,
+                                float max_force, struct fade_acc* acc)
+{
+        const struct display_quad* tree = &self->fade.tree;
+        int i;
+        for (i = na->first; i < na->first + na->count; i ++) {
+                self->repulse(tree->sorted_x[i], tree->sorted_y[i], &tree->sorted_x[nb->first], &tree->sorted_y[nb->first],
+                              nb->count, c_c3, max_force, &acc->vert_acc[2*tree->indices[i]]);
+        }
+}
+
+// repulsion between the vertices below node a and those below node b
+static void __fade_interact(struct graph_display* self, int a, int b, float scale_xy, struct fade_acc* acc)
+{
+        const struct display_quad* tree = &self->fade.tree;
+        const struct display_quad_node* na = &tree->nodes[a];
+        const struct display_quad_node* nb = &tree->nodes[b];
+        bool a_leaf = __quad_is_leaf(na);
+        bool b_leaf = __quad_is_leaf(nb);
+        int i, j, c;
+        if (a == b) {
+                if (a_leaf) {
+                        __fade_leaf_to_leaf(self, na, na, scale_xy/10.0f, acc);
+                } else {
+                        for (i = 0; i < 4; i ++) {
+                                if (na->children[i] == -1) continue;
+                                for (j = i; j < 4; j ++) {
+                                        if (na->children[j] == -1) continue;
+                                        __fade_interact(self, na->children[i], na->children[j], scale_xy, acc);
+                                }
+                        }
+                }
+                return ;
+        }
+        if (__fade_separated(tree, na, nb)) {
+                // well separated: every vertex of a feels b as one particle and vice versa
+                float vx = nb->centroid_x - na->centroid_x;
+                float vy = nb->centroid_y - na->centroid_y;
+                float dist2 = vx*vx + vy*vy;
+                float dist = sqrtf(dist2);
+                vx /= dist;
+                vy /= dist;
+                float f_a = CLAMP(-nb->mass*c_c3/dist2, -scale_xy/10.0f, 0.0f);
+                float f_b = CLAMP(-na->mass*c_c3/dist2, -scale_xy/10.0f, 0.0f);
+                acc->node_acc_x[a] += vx*f_a;
+                acc->node_acc_y[a] += vy*f_a;
+                acc->node_acc_x[b] -= vx*f_b;
+                acc->node_acc_y[b] -= vy*f_b;
+        } else if (a_leaf && b_leaf) {
+                __fade_leaf_to_leaf(self, na, nb, scale_xy/10.0f, acc);
+                __fade_leaf_to_leaf(self, nb, na, scale_xy/10.0f, acc);
+        } else if (__fade_opens_a(na, nb)) {
+                // open the larger of the two
+                for (c = 0; c < 4; c ++) {
+                        if (na->children[c] != -1) {
+                                __fade_interact(self, na->children[c], b, scale_xy, acc);
+                        }
+                }
+        } else {
+                for (c = 0; c < 4; c ++) {
+                        if (nb->children[c] != -1) {
+                                __fade_interact(self, a, nb->children[c], scale_xy, acc);
+                        }
+                }
+        }
 }
 
-static void __vertex_electrical_acceleration_with_grid(const struct bio_graph_vertex* v, void* user_data)
+// splits the interaction of the root with itself into node pairs the threads can take one by
+// one, opening nodes the same way __fade_interact does
+#define c_FadeTaskDepth         3
+
+static void __fade_push_pair(struct display_fade* self, int a, int b)
+{
+        if (self->num_pairs == self->pair_capacity) {
+                self->pair_capacity = MAX(64, self->pair_capacity*2);
+                self->pairs = realloc(self->pairs, sizeof(*self->pairs)*2*self->pair_capacity);
+        }
+        self->pairs[2*self->num_pairs + 0] = a;
+        self->pairs[2*self->num_pairs + 1] = b;
+        self->num_pairs ++;
+}
+
+static void __fade_collect_pairs(struct display_fade* self, int a, int b, int depth)
+{
+        const struct display_quad* tree = &self->tree;
+        const struct display_quad_node* na = &tree->nodes[a];
+        const struct display_quad_node* nb = &tree->nodes[b];
+        int i, j, c;
+        if (depth >= c_FadeTaskDepth || (__quad_is_leaf(na) && __quad_is_leaf(nb))) {
+                __fade_push_pair(self, a, b);
+        } else if (a == b) {
+                for (i = 0; i < 4; i ++) {
+                        if (na->children[i] == -1) continue;
+                        for (j = i; j < 4; j ++) {
+                                if (na->children[j] == -1) continue;
+                                __fade_collect_pairs(self, na->children[i], na->children[j], depth + 1);
+                        }
+                }
+        } else if (__fade_separated(tree, na, nb)) {
+                __fade_push_pair(self, a, b);
+        } else if (__fade_opens_a(na, nb)) {
+                for (c = 0; c < 4; c ++) {
+                        if (na->children[c] != -1) {
+                                __fade_collect_pairs(self, na->children[c], b, depth + 1);
+                        }
+                }
+        } else {
+                for (c = 0; c < 4; c ++) {
+                        if (nb->children[c] != -1) {
+                                __fade_collect_pairs(self, a, nb->children[c], depth + 1);
+                        }
+                }
+        }
+}
+
+// slot s owns every num_slots-th pair starting at s, dealt round robin so that the expensive pairs
+// near the diagonal spread over the slots
+static void __fade_task(int thread_id, int num_threads, void* user_data)
 {
         struct graph_display* self = user_data;
-        struct display_vertex* v0 = bio_graph_vertex_retrieve_data(v);
-        struct display_cell** cells;
-        int n_cells;
-        cells = __grid_which_cells_within_radius(&self->grid, v0->pos_x, v0->pos_y, 15.0f, &n_cells);
-        // interaction of points in nearby cells
+        struct display_fade* fade = &self->fade;
         float x_scale, y_scale;
         __data_get_scale(&self->data, &x_scale, &y_scale);
-        float scale_xy = (x_scale + y_scale)*0.5f;
-        int id = bio_graph_vertex_get_id(v);
-        int i;
-        for (i = 0; i < n_cells; i ++) {
-                __calc_electrical_acc(v0, cells[i]->verts, cells[i]->num_verts, scale_xy);
-                cells[i]->id_marker = id;
+        int s, k;
+        while ((s = __atomic_fetch_add(&self->next_chunk, 1, __ATOMIC_RELAXED)) < self->num_slots) {
+                struct fade_acc acc;
+                acc.node_acc_x  = &fade->node_acc_x[fade->node_capacity*s];
+                acc.node_acc_y  = &fade->node_acc_y[fade->node_capacity*s];
+                acc.vert_acc    = __slot_acc(self, s);
+                for (k = s; k < fade->num_pairs; k += self->num_slots) {
+                        __fade_interact(self, fade->pairs[2*k + 0], fade->pairs[2*k + 1], (x_scale + y_scale)*0.5f, &acc);
+                }
         }
-        // interaction between v and grids
-        struct display_grid* grid = &self->grid;
-        int j;
-        for (i = 0; i < grid->n_grid_y; i ++) {
-                for (j = 0; j < grid->n_grid_x; j ++) {
-                        int p = j + i*grid->n_grid_x;
-                        if (grid->cells[p].num_verts == 0 || grid->cells[p].id_marker == id) {
-                                goto omit;
+}
+
+static void __fade_electrical_acceleration(struct graph_display* self)
+{
+        struct display_fade* fade = &self->fade;
+        struct display_quad* tree = &fade->tree;
+        if (tree->num_nodes == 0) {
+                return ;
+        }
+        fade->num_pairs = 0;
+        __fade_collect_pairs(fade, 0, 0, 0);
+        self->next_chunk = 0;
+        parallel_pool_run(self->pool, self->num_threads, __fade_task, self);
+        // the node accelerations of all slots end up in the first buffer. the buffers start out
+        // zeroed and are cleared again as they are consumed
+        int n, c, i, s;
+        for (s = 1; s < self->num_slots; s ++) {
+                for (n = 0; n < tree->num_nodes; n ++) {
+                        fade->node_acc_x[n] += fade->node_acc_x[fade->node_capacity*s + n];
+                        fade->node_acc_y[n] += fade->node_acc_y[fade->node_capacity*s + n];
+                        fade->node_acc_x[fade->node_capacity*s + n] = 0.0f;
+                        fade->node_acc_y[fade->node_capacity*s + n] = 0.0f;
+                }
+        }
+        // push the node accelerations down, parents come before their children
+        struct display_data* data = &self->data;
+        for (n = 0; n < tree->num_nodes; n ++) {
+                const struct display_quad_node* node = &tree->nodes[n];
+                float acc_x = fade->node_acc_x[n];
+                float acc_y = fade->node_acc_y[n];
+                fade->node_acc_x[n] = 0.0f;
+                fade->node_acc_y[n] = 0.0f;
+                if (__quad_is_leaf(node)) {
+                        for (i = node->first; i < node->first + node->count; i ++) {
+                                data->acc_x[tree->indices[i]] += acc_x;
+                                data->acc_y[tree->indices[i]] += acc_y;
+                        }
+                        continue;
+                }
+                for (c = 0; c < 4; c ++) {
+                        if (node->children[c] != -1) {
+                                fade->node_acc_x[node->children[c]] += acc_x;
+                                fade->node_acc_y[node->children[c]] += acc_y;
                         }
-                        float mass = grid->cells[p].num_verts;
-                        float vx = grid->cells[p].centroid_x - v0->pos_x;
-                        float vy = grid->cells[p].centroid_y - v0->pos_y;
-                        float dist2 = vx*vx + vy*vy;
-                        float dist = sqrtf(dist2);
-                        float f_electron = CLAMP(-mass*c_c3/dist2, -scale_xy/10.0f, 0.0f);
-                        vx /= dist;
-                        vy /= dist;
-                        v0->acc_x += vx*f_electron;
-                        v0->acc_y += vy*f_electron;
-omit:;
                 }
         }
+        // and the vertex to vertex terms
+        parallel_pool_run(self->pool, self->num_threads, __reduce_task, self);
+}
+
+// splitmix64, every layout run starts it from the seed
+static uint64_t __random_next(struct graph_display* self)
+{
+        uint64_t z = (self->random += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+}
+
+// uniform in [0, 1)
+static float __random_float(struct graph_display* self)
+{
+        return (__random_next(self) >> 40)*(1.0f/(1 << 24));
 }
 
 static void __preparation_step(struct graph_display* self, struct bio_graph* g)
@@ -446,67 +1209,146 @@ static void __preparation_step(struct graph_display* self, struct bio_graph* g)
         __data_retrieve_data_from_graph(&self->data, g);
         float x_scale, y_scale;
         __data_get_scale(&self->data, &x_scale, &y_scale);
-        struct display_vertex* verts = __data_get_vertices(&self->data);
+        struct display_data* data = &self->data;
         int i;
-        for (i = 0; i < __data_get_vertex_num(&self->data); i ++) {
-                verts[i].pos_x = (rand()%10001)/10000.0f*x_scale;
-                verts[i].pos_y = (rand()%10001)/10000.0f*y_scale;
-                verts[i].acc_x = 0.0f;
-                verts[i].acc_y = 0.0f;
+        for (i = 0; i < __data_get_vertex_num(data); i ++) {
+                data->pos_x[i] = __random_float(self)*x_scale;
+                data->pos_y[i] = __random_float(self)*y_scale;
+                data->acc_x[i] = 0.0f;
+                data->acc_y[i] = 0.0f;
+        }
+        // small graphs are not worth waking the workers for
+        if (self->pool == nullptr) {
+                self->pool = parallel_pool_create(parallel_get_num_threads());
         }
-        // allocate for grid subdivide
+        int n = __data_get_vertex_num(&self->data);
+        self->num_threads = n >= c_MinParallelVerts ? parallel_pool_get_num_threads(self->pool) : 1;
+        self->num_slots = n >= c_MinParallelVerts ? c_FadeSlots : 1;
+        free(self->slot_acc);
+        self->slot_acc = self->use_fade ? calloc(2*MAX(1, n)*self->num_slots, sizeof(*self->slot_acc)) : nullptr;
+        // allocate for grid subdivide. per vertex the cost is about 9n/cells exact terms plus one
+        // term per cell, which is lowest around 3*sqrt(n) cells
         if (self->use_grid) {
-                int n = __data_get_vertex_num(&self->data)/4;
-                int nxy = (int) sqrtf((float) n);
-                __grid_init(&self->grid, nxy, nxy);
-                __grid_reserve_vertex_count(&self->grid, __data_get_vertex_num(&self->data));
+                int nxy = (int) ceilf(sqrtf(3.0f*sqrtf((float) n)));
+                __grid_free(&self->grid);
+                __grid_init(&self->grid, nxy, nxy, n);
+        }
+}
+
+// adaptive cooling after hu: vertices move by step times their acceleration. the step grows after
+// c_CoolingPatience steps in a row that lowered the energy (sum of the squared accelerations) and
+// shrinks after every step that did not, never growing past c_MaxStepGrowth times the step the run
+// started with, as refinement runs start cool on purpose and overshoot when heated up much further.
+// the energy is compared against a running average since the approximated repulsion makes it noisy.
+// on top of that every vertex moves by its own share (heat) of the step: a vertex whose acceleration
+// turned against the one of the previous step is oscillating around its place and cools by itself,
+// the others warm back up to the full step, so a few jittering vertices do not hold the step of the
+// whole system down. the run has converged once the mean displacement falls below tolerance times
+// the layout scale.
+#define c_CoolingRate           0.9f
+#define c_CoolingPatience       5
+#define c_EnergySmoothing       0.9f
+#define c_MaxStepGrowth         2.0f
+#define c_InitialStep           0.1f
+#define c_VertexCooling         0.8f
+#define c_VertexWarming         1.1f
+
+static void __reset_cooling(struct graph_display* self, float step)
+{
+        self->step      = step;
+        self->max_step  = step*c_MaxStepGrowth;
+        self->energy    = FLT_MAX;
+        self->progress  = 0;
+        self->stats.num_steps   = 0;
+        self->stats.converged   = false;
+        struct display_data* data = &self->data;
+        int v;
+        for (v = 0; v < data->num_verts; v ++) {
+                data->heat[v] = 1.0f;
+                data->last_ax[v] = 0.0f;
+                data->last_ay[v] = 0.0f;
         }
 }
 
+static void __record_energy(struct graph_display* self, float energy)
+{
+        if (self->stats.num_steps == self->energy_capacity) {
+                self->energy_capacity = MAX(256, self->energy_capacity*2);
+                self->energies = realloc(self->energies, sizeof(*self->energies)*self->energy_capacity);
+                self->stats.energies = self->energies;
+        }
+        self->energies[self->stats.num_steps ++] = energy;
+        self->stats.total_steps ++;
+}
+
 static int __simulation_step(struct graph_display* self, int i)
 {
         // simulate mechanical system
-#define c_MaxSimulatingSteps               2000
-        if (i >= c_MaxSimulatingSteps || i == -1) {
+        if (i >= self->max_steps || i == -1) {
                 return -1;
         }
 
-        struct bio_graph* graph = __data_get_graph(&self->data);
-        if (self->use_grid) {
-                // initialize grid setup
-                __grid_update_with_vertex(&self->grid, &self->data);
-                // compute acceleration with grid
-                bio_graph_visit_edges(graph, __edge_string_acceleration, self);
-                bio_graph_visit_vertices(graph, __vertex_electrical_acceleration_with_grid, self);
+        // springs
+        self->next_chunk = 0;
+        parallel_pool_run(self->pool, self->num_threads, __spring_task, self);
+        self->next_chunk = 0;
+        parallel_pool_run(self->pool, self->num_threads, __spring_gather_task, self);
+        // repulsion
+        if (self->use_fade) {
+                // refit the tree, or rebuild it every few steps
+                __fade_update(&self->fade, self->data.pos_x, self->data.pos_y, __data_get_vertex_num(&self->data),
+                              self->num_slots);
+                __fade_electrical_acceleration(self);
         } else {
-                // compute acceleration
-                bio_graph_visit_edges(graph, __edge_string_acceleration, self);
-                bio_graph_visit_vertices(graph, __vertex_electrical_acceleration, self);
+                if (self->use_grid) {
+                        __grid_update_with_vertex(&self->grid, &self->data);
+                } else if (self->use_quad) {
+                        // rebuild the quadtree on the current positions
+                        __quad_build(&self->quad, self->data.pos_x, self->data.pos_y, __data_get_vertex_num(&self->data));
+                }
+                self->next_chunk = 0;
+                parallel_pool_run(self->pool, self->num_threads, __repulsion_task, self);
         }
         // move vertices
-        // cooling schedule: t = e^-(i/max_steps)^2
-        float width = (float) i/c_MaxSimulatingSteps;
-        float d_limit = 0.1f*exp(-width*width);
-
-        float acc_sum = 0.0f;
-        struct display_vertex* verts    = __data_get_vertices(&self->data);
+        float energy = 0.0f;
+        float moved = 0.0f;
+        struct display_data* data       = &self->data;
         int n_verts                     = __data_get_vertex_num(&self->data);
         int j;
         for (j = 0; j < n_verts; j ++) {
-                float mass = MAX(1.0f, verts[j].mass);
-                float dx = d_limit*verts[j].acc_x/mass;
-                float dy = d_limit*verts[j].acc_y/mass;
-                verts[j].pos_x = verts[j].pos_x + dx;
-                verts[j].pos_y = verts[j].pos_y + dy;
-                acc_sum += fabs(dy) + fabs(dy);
-                verts[j].acc_x = 0.0f;
-                verts[j].acc_y = 0.0f;
-        }
-        acc_sum /= (2.0f*n_verts);
+                float ax = data->acc_x[j]*data->inv_mass[j];
+                float ay = data->acc_y[j]*data->inv_mass[j];
+                float a2 = ax*ax + ay*ay;
+                float heat = ax*data->last_ax[j] + ay*data->last_ay[j] < 0.0f ?
+                             data->heat[j]*c_VertexCooling : MIN(1.0f, data->heat[j]*c_VertexWarming);
+                float step = self->step*heat;
+                data->heat[j] = heat;
+                data->last_ax[j] = ax;
+                data->last_ay[j] = ay;
+                data->pos_x[j] += step*ax;
+                data->pos_y[j] += step*ay;
+                energy += a2;
+                moved += step*sqrtf(a2);
+                data->acc_x[j] = 0.0f;
+                data->acc_y[j] = 0.0f;
+        }
+        __record_energy(self, energy);
+        if (energy < self->energy) {
+                if (++ self->progress >= c_CoolingPatience) {
+                        self->progress = 0;
+                        self->step = MIN(self->step/c_CoolingRate, self->max_step);
+                }
+        } else {
+                self->progress = 0;
+                self->step *= c_CoolingRate;
+        }
+        self->energy = self->energy == FLT_MAX ?
+                       energy : c_EnergySmoothing*self->energy + (1.0f - c_EnergySmoothing)*energy;
         // determine cut-off
         float x_scale, y_scale;
         __data_get_scale(&self->data, &x_scale, &y_scale);
-        if (fabs(acc_sum) < 0.00001*(x_scale + y_scale)) {
+        if (moved/MAX(1, n_verts) < self->tolerance*(x_scale + y_scale)) {
+                self->stats.converged = true;
                 return -1;
         }
         return ++ i;
@@ -517,20 +1359,245 @@ static void __finalize_step(struct graph_display* self)
         __data_redefine_system_position(&self->data);
 }
 
+static void __begin_simulation(struct graph_display* self, float step, int max_steps)
+{
+        __reset_cooling(self, step);
+        self->max_steps = max_steps;
+}
+
+static void __run_simulation(struct graph_display* self, float step, int max_steps)
+{
+        __begin_simulation(self, step, max_steps);
+        int i = 0;
+        while (i != -1) {
+               i = __simulation_step(self, i);
+        }
+}
+
+// multilevel layout: the graph is coarsened by matching each vertex with its lightest
+// unmatched neighbour (or collapsing it into a neighbour when none is left) until it is
+// small. the coarsest graph is laid out from scratch and every finer level starts from
+// the positions of its coarse parents and is only refined
+#define c_MultilevelMaxLevels           32
+#define c_MultilevelCoarsestVerts       64
+#define c_MultilevelRefineSteps         150
+#define c_MultilevelRefineStep          0.04f
+#define c_MultilevelJitter              0.1f
+
+static struct bio_graph* __multilevel_coarsen(const struct bio_graph* g, int* parents)
+{
+        const int* row_offsets;
+        const int* col_ids;
+        bio_graph_get_csr(g, &row_offsets, &col_ids);
+        int n = bio_graph_get_vertex_num(g);
+        int num_coarse = 0;
+        int v, k;
+        for (v = 0; v < n; v ++) {
+                parents[v] = -1;
+        }
+        for (v = 0; v < n; v ++) {
+                if (parents[v] != -1) {
+                        continue;
+                }
+                int mate = -1;
+                int lightest = -1;
+                for (k = row_offsets[v]; k < row_offsets[v + 1]; k ++) {
+                        int w = col_ids[k];
+                        int degree = row_offsets[w + 1] - row_offsets[w];
+                        if (w == v) {
+                                continue;
+                        }
+                        if (parents[w] == -1 && (mate == -1 || degree < row_offsets[mate + 1] - row_offsets[mate])) {
+                                mate = w;
+                        }
+                        if (lightest == -1 || degree < row_offsets[lightest + 1] - row_offsets[lightest]) {
+                                lightest = w;
+                        }
+                }
+                if (mate == -1 && lightest != -1) {
+                        // every neighbour is taken (e.g. the leaves of a hub), collapse into one of them
+                        parents[v] = parents[lightest];
+                        continue;
+                }
+                parents[v] = num_coarse;
+                if (mate != -1) {
+                        parents[mate] = num_coarse;
+                }
+                num_coarse ++;
+        }
+        // edges between different parents, the bulk builder drops the duplicates
+        int* edges = malloc(sizeof(*edges)*MAX(1, row_offsets[n]));
+        int num_edges = 0;
+        for (v = 0; v < n; v ++) {
+                for (k = row_offsets[v]; k < row_offsets[v + 1]; k ++) {
+                        int w = col_ids[k];
+                        if (v < w && parents[v] != parents[w]) {
+                                edges[2*num_edges + 0] = parents[v];
+                                edges[2*num_edges + 1] = parents[w];
+                                num_edges ++;
+                        }
+                }
+        }
+        struct bio_graph* coarse = bio_graph_create(num_coarse);
+        bio_graph_make_edges_undirected(coarse, edges, num_edges);
+        bio_graph_freeze(coarse);
+        free(edges);
+        return coarse;
+}
+
+// lays out every coarser level of g and leaves the display on g with its vertices next to their
+// coarse parents, ready for the refinement. false when g is too small to coarsen, the display is
+// not touched then
+static bool __multilevel_prolong(struct graph_display* self, struct bio_graph* g, int max_steps)
+{
+        struct bio_graph* levels[c_MultilevelMaxLevels];
+        int* parents[c_MultilevelMaxLevels];
+        int num_levels = 1;
+        levels[0] = g;
+        while (num_levels < c_MultilevelMaxLevels) {
+                struct bio_graph* fine = levels[num_levels - 1];
+                int n = bio_graph_get_vertex_num(fine);
+                if (n <= c_MultilevelCoarsestVerts) {
+                        break;
+                }
+                int* p = malloc(sizeof(*p)*n);
+                struct bio_graph* coarse = __multilevel_coarsen(fine, p);
+                if (bio_graph_get_vertex_num(coarse) > 0.9f*n) {
+                        // mostly isolated vertices left, matching no longer pays off
+                        bio_graph_free(coarse);
+                        free(p);
+                        break;
+                }
+                parents[num_levels - 1] = p;
+                levels[num_levels ++] = coarse;
+        }
+        if (num_levels == 1) {
+                return false;
+        }
+
+        __preparation_step(self, levels[num_levels - 1]);
+        __run_simulation(self, c_InitialStep, max_steps);
+        int l, v;
+        for (l = num_levels - 2; l >= 0; l --) {
+                // prolong: every vertex starts next to its coarse parent
+                int num_coarse = __data_get_vertex_num(&self->data);
+                float* coarse_pos = malloc(sizeof(*coarse_pos)*2*MAX(1, num_coarse));
+                for (v = 0; v < num_coarse; v ++) {
+                        coarse_pos[2*v + 0] = self->data.pos_x[v];
+                        coarse_pos[2*v + 1] = self->data.pos_y[v];
+                }
+                __preparation_step(self, levels[l]);
+                for (v = 0; v < __data_get_vertex_num(&self->data); v ++) {
+                        int p = parents[l][v];
+                        self->data.pos_x[v] = coarse_pos[2*p + 0] + (2.0f*__random_float(self) - 1.0f)*c_MultilevelJitter;
+                        self->data.pos_y[v] = coarse_pos[2*p + 1] + (2.0f*__random_float(self) - 1.0f)*c_MultilevelJitter;
+                }
+                free(coarse_pos);
+                free(parents[l]);
+                bio_graph_free(levels[l + 1]);
+                if (l > 0) {
+                        // refine, starting cool
+                        __run_simulation(self, c_MultilevelRefineStep, MIN(max_steps, c_MultilevelRefineSteps));
+                }
+        }
+        return true;
+}
+
+// warm start: vertices of the previous layout keep their position, the others are put at the
+// centroid of their placed neighbours, one ring further out per pass. vertices that cannot be
+// reached from a placed one stay where the preparation step put them
+#define c_WarmStartStep         0.02f
+#define c_WarmStartJitter       0.1f
+
+static bool __warm_start(struct graph_display* self)
+{
+        struct display_data* data = &self->data;
+        int n = __data_get_vertex_num(data);
+        if (self->initial_x == nullptr || self->initial_num != n) {
+                return false;
+        }
+        const int* row_offsets;
+        const int* col_ids;
+        bio_graph_get_csr(data->graph, &row_offsets, &col_ids);
+        int* ring = malloc(sizeof(*ring)*MAX(1, n));
+        int v, k;
+        for (v = 0; v < n; v ++) {
+                if (self->initial_placed[v]) {
+                        data->pos_x[v] = self->initial_x[v];
+                        data->pos_y[v] = self->initial_y[v];
+                        ring[v] = 0;
+                } else {
+                        ring[v] = -1;
+                }
+        }
+        int r;
+        bool progress = true;
+        for (r = 1; progress; r ++) {
+                progress = false;
+                for (v = 0; v < n; v ++) {
+                        if (ring[v] != -1) {
+                                continue;
+                        }
+                        float cx = 0.0f, cy = 0.0f;
+                        int count = 0;
+                        for (k = row_offsets[v]; k < row_offsets[v + 1]; k ++) {
+                                int w = col_ids[k];
+                                if (ring[w] != -1 && ring[w] < r) {
+                                        cx += data->pos_x[w];
+                                        cy += data->pos_y[w];
+                                        count ++;
+                                }
+                        }
+                        if (count > 0) {
+                                data->pos_x[v] = cx/count + (2.0f*__random_float(self) - 1.0f)*c_WarmStartJitter;
+                                data->pos_y[v] = cy/count + (2.0f*__random_float(self) - 1.0f)*c_WarmStartJitter;
+                                ring[v] = r;
+                                progress = true;
+                        }
+                }
+        }
+        free(ring);
+        return true;
+}
+
+// sets the display up on g for a layout run and starts the simulation of g itself
+static void __begin_layout(struct graph_display* self, struct bio_graph* g, int max_steps)
+{
+        // non-positive picks the default
+        if (max_steps <= 0) {
+                max_steps = c_DefaultMaxSteps;
+        }
+        self->stats.total_steps = 0;
+        self->random = self->seed;
+        if (self->initial_x != nullptr && self->initial_num == bio_graph_get_vertex_num(g)) {
+                // a previous layout is close already, refine it without coarsening
+                __preparation_step(self, g);
+                __warm_start(self);
+                __begin_simulation(self, c_WarmStartStep, max_steps);
+        } else if (self->use_multilevel && __multilevel_prolong(self, g, max_steps)) {
+                // refine, starting cool
+                __begin_simulation(self, c_MultilevelRefineStep, MIN(max_steps, c_MultilevelRefineSteps));
+        } else {
+                __preparation_step(self, g);
+                __begin_simulation(self, c_InitialStep, max_steps);
+        }
+}
+
 void graph_display_force_directed(struct graph_display* self, struct bio_graph* g, int max_steps)
 {
-        __preparation_step(self, g);
-        int i, j;
-        for (i= 0, j = 0; j < max_steps && i != -1; j ++) {
+        __begin_layout(self, g, max_steps);
+        int i = 0;
+        while (i != -1) {
                i = __simulation_step(self, i);
         }
         __finalize_step(self);
 }
 
-int graph_display_force_directed_progressive(struct graph_display* self, struct bio_graph* g, int iterator)
+int graph_display_force_directed_progressive(struct graph_display* self, struct bio_graph* g, int max_steps, int iterator)
 {
+        // the coarse levels of a multilevel layout are laid out at once, only g itself is progressive
         if (iterator == 0) {
-                __preparation_step(self, g);
+                __begin_layout(self, g, max_steps);
         }
         int i = __simulation_step(self, iterator);
         __finalize_step(self);
@@ -629,15 +1696,15 @@ static void graph_display_rasterize_edge(const struct bio_graph_vertex* v0, cons
         struct edge_pack* pack = user_data;
         struct graph_display* self = pack->display;
 
-        struct display_vertex* dv0 = bio_graph_vertex_retrieve_data(v0);
-        struct display_vertex* dv1 = bio_graph_vertex_retrieve_data(v1);
+        int id0 = bio_graph_vertex_get_id(v0);
+        int id1 = bio_graph_vertex_get_id(v1);
 
         float x_scale, y_scale;
         __data_get_scale(&self->data, &x_scale, &y_scale);
-        int px0 = dv0->pos_x/x_scale*(self->width - 1);
-        int py0 = dv0->pos_y/y_scale*(self->height - 1);
-        int px1 = dv1->pos_x/x_scale*(self->width - 1);
-        int py1 = dv1->pos_y/y_scale*(self->height - 1);
+        int px0 = self->data.pos_x[id0]/x_scale*(self->width - 1);
+        int py0 = self->data.pos_y[id0]/y_scale*(self->height - 1);
+        int px1 = self->data.pos_x[id1]/x_scale*(self->width - 1);
+        int py1 = self->data.pos_y[id1]/y_scale*(self->height - 1);
 
         __draw_line(px0, py0, px1, py1, &pack->edge_color, self->buffer, self->width, self->height, self->stride, self->ps);
 }
@@ -657,12 +1724,11 @@ void graph_display_rasterize(struct graph_display* self)
         // draw vertices
         struct graph_display_color dots;
         dots.r = 255; dots.g = 0; dots.b = 0;
-        struct display_vertex* verts = __data_get_vertices(&self->data);
         float x_scale, y_scale;
         __data_get_scale(&self->data, &x_scale, &y_scale);
         for (i = 0; i < __data_get_vertex_num(&self->data); i ++) {
-                int px = verts[i].pos_x/x_scale*(self->width - 1);
-                int py = verts[i].pos_y/y_scale*(self->height - 1);
+                int px = self->data.pos_x[i]/x_scale*(self->width - 1);
+                int py = self->data.pos_y[i]/y_scale*(self->height - 1);
                 __draw_circle(px, py, 4, &dots, image, self->stride, self->ps, self->width, self->height);
         }
         // draw edges
@@ -681,6 +1747,7 @@ struct gtk_display_pack {
         int                             iterator;
         struct graph_display*           display;
         struct bio_graph*               graph;
+        int                             max_steps;
         bool                            first_time;
 };
 
@@ -691,7 +1758,7 @@ static gboolean __display_callback(GtkWidget *widget, cairo_t *cairo, gpointer u
         struct graph_display* display           = pack->display;
         struct bio_graph* graph                 = pack->graph;
 
-        pack->iterator = graph_display_force_directed_progressive(display, graph, pack->iterator);
+        pack->iterator = graph_display_force_directed_progressive(display, graph, pack->max_steps, pack->iterator);
         if (pack->iterator != -1 || pack->first_time) {
                 graph_display_rasterize(display);
                 pack->first_time = false;
@@ -715,7 +1782,7 @@ static gboolean __activiate_draw(gpointer user_data)
         return 1;
 }
 
-static void __make_gtk_window(struct graph_display* self, struct bio_graph* g)
+static void __make_gtk_window(struct graph_display* self, struct bio_graph* g, int max_steps)
 {
         GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
         gtk_window_set_title(GTK_WINDOW (window), "Bio-Graph Display");
@@ -728,6 +1795,7 @@ static void __make_gtk_window(struct graph_display* self, struct bio_graph* g)
         struct gtk_display_pack pack;
         pack.display    = self;
         pack.graph      = g;
+        pack.max_steps  = max_steps;
         pack.iterator   = 0;
         pack.first_time = true;
         g_signal_connect(draw_area, "draw", G_CALLBACK(__display_callback), (gpointer) &pack);
@@ -742,14 +1810,14 @@ static void __make_gtk_window(struct graph_display* self, struct bio_graph* g)
 #endif // USE_GTK
 
 
-void graph_display_progressive_draw_to_gtk_screen(struct graph_display* self, struct bio_graph* g,
+void graph_display_progressive_draw_to_gtk_screen(struct graph_display* self, struct bio_graph* g, int max_steps,
                                                   GtkWidget* widget, int* argc, char*** argv)
 {
 #ifdef USE_GTK
         printf("Launching gui for display...\n");
         if (!widget) {
                 gtk_init(argc, argv);
-                __make_gtk_window(self, g);
+                __make_gtk_window(self, g, max_steps);
         }
 #endif // USE_GTK
 }
@@ -22,16 +22,37 @@ enum AccelerateMethod {
         AccelerateMethodNone,
         AccelerateMethodGrid,
         AccelerateMethodFADE,
+        AccelerateMethodBarnesHut,
         c_NumAccelerateMethod
 };
 
+// what the last layout run did. with multilevel layouts num_steps and the energy curve are those of
+// the finest level, total_steps counts the steps of every level.
+struct graph_display_stats {
+        int                     num_steps;
+        int                     total_steps;
+        bool                    converged;      // false when the run stopped at max_steps
+        const float*            energies;       // sum of squared accelerations after each step
+};
+
 struct graph_display*   graph_display_create(enum AccelerateMethod acc);
 void                    graph_display_free(struct graph_display* self);
 void                    graph_display_set_dimension(struct graph_display* self, int width, int height);
+void                    graph_display_set_theta(struct graph_display* self, float theta);
+void                    graph_display_set_multilevel(struct graph_display* self, bool use_multilevel);
+void                    graph_display_set_tolerance(struct graph_display* self, float tolerance);
+void                    graph_display_set_seed(struct graph_display* self, uint64_t seed);
+const struct graph_display_stats*
+                        graph_display_get_stats(const struct graph_display* self);
+void                    graph_display_set_initial_layout(struct graph_display* self, const float* pos_x, const float* pos_y,
+                                                         const bool* placed, int num_verts);
+void                    graph_display_get_layout(const struct graph_display* self, const float** pos_x, const float** pos_y,
+                                                 int* num_verts);
 void                    graph_display_force_directed(struct graph_display* self, struct bio_graph* g, int max_steps);
-int                     graph_display_force_directed_progressive(struct graph_display* self, struct bio_graph* g, int iterator);
+int                     graph_display_force_directed_progressive(struct graph_display* self, struct bio_graph* g, int max_steps,
+                                                                 int iterator);
 void                    graph_display_rasterize(struct graph_display* self);
-void                    graph_display_progressive_draw_to_gtk_screen(struct graph_display* self, struct bio_graph* g,
+void                    graph_display_progressive_draw_to_gtk_screen(struct graph_display* self, struct bio_graph* g, int max_steps,
                                                                      GtkWidget* widget, int* argc, char*** argv);
 const void*             graph_display_fetch_memory(const struct graph_display* self, int* width, int* height, int* ps);
 
@@ -0,0 +1,166 @@
+#include "common.h"
+#include "graph_display_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define USE_X86_KERNELS
+#endif
+
+
+// pairs closer than sqrt(c_MinDist2) are pushed apart as if they were c_MinDist apart
+static const float c_MinDist2 = 1e-3f;
+static const float c_MinDist = 1e-3f;
+
+static void __repulsion_scalar(float x0, float y0, const float* xs, const float* ys, int count,
+                               float charge, float max_force, float* acc)
+{
+        float acc_x = 0.0f, acc_y = 0.0f;
+        int i;
+        for (i = 0; i < count; i ++) {
+                float vx = xs[i] - x0;
+                float vy = ys[i] - y0;
+                float d2 = vx*vx + vy*vy;
+                float inv = d2 < c_MinDist2 ? 1.0f/c_MinDist : 1.0f/sqrtf(d2);
+                float f = MAX(-charge*inv*inv, -max_force)*inv;
+                acc_x += vx*f;
+                acc_y += vy*f;
+        }
+        acc[0] += acc_x;
+        acc[1] += acc_y;
+}
+
+#ifdef USE_X86_KERNELS
+
+// the rsqrt estimates are good to about 12 bits, one newton step takes them to about 23:
+// y' = y*(1.5 - 0.5*d2*y*y)
+
+__attribute__((target("sse2")))
+static void __repulsion_sse(float x0, float y0, const float* xs, const float* ys, int count,
+                            float charge, float max_force, float* acc)
+{
+        __m128 px = _mm_set1_ps(x0);
+        __m128 py = _mm_set1_ps(y0);
+        __m128 min_d2 = _mm_set1_ps(c_MinDist2);
+        __m128 max_inv = _mm_set1_ps(1.0f/c_MinDist);
+        __m128 neg_charge = _mm_set1_ps(-charge);
+        __m128 neg_max = _mm_set1_ps(-max_force);
+        __m128 half = _mm_set1_ps(0.5f);
+        __m128 three_halves = _mm_set1_ps(1.5f);
+        __m128 sum_x = _mm_setzero_ps();
+        __m128 sum_y = _mm_setzero_ps();
+        int i;
+        for (i = 0; i + 4 <= count; i += 4) {
+                __m128 vx = _mm_sub_ps(_mm_loadu_ps(&xs[i]), px);
+                __m128 vy = _mm_sub_ps(_mm_loadu_ps(&ys[i]), py);
+                __m128 d2 = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+                __m128 close = _mm_cmplt_ps(d2, min_d2);
+                d2 = _mm_max_ps(d2, min_d2);
+                __m128 inv = _mm_rsqrt_ps(d2);
+                inv = _mm_mul_ps(inv, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(half, d2), _mm_mul_ps(inv, inv))));
+                inv = _mm_or_ps(_mm_andnot_ps(close, inv), _mm_and_ps(close, max_inv));
+                __m128 f = _mm_mul_ps(_mm_max_ps(_mm_mul_ps(neg_charge, _mm_mul_ps(inv, inv)), neg_max), inv);
+                sum_x = _mm_add_ps(sum_x, _mm_mul_ps(vx, f));
+                sum_y = _mm_add_ps(sum_y, _mm_mul_ps(vy, f));
+        }
+        float lanes_x[4], lanes_y[4];
+        _mm_storeu_ps(lanes_x, sum_x);
+        _mm_storeu_ps(lanes_y, sum_y);
+        acc[0] += (lanes_x[0] + lanes_x[1]) + (lanes_x[2] + lanes_x[3]);
+        acc[1] += (lanes_y[0] + lanes_y[1]) + (lanes_y[2] + lanes_y[3]);
+        __repulsion_scalar(x0, y0, &xs[i], &ys[i], count - i, charge, max_force, acc);
+}
+
+__attribute__((target("avx2,fma")))
+static void __repulsion_avx2(float x0, float y0, const float* xs, const float* ys, int count,
+                             float charge, float max_force, float* acc)
+{
+        __m256 px = _mm256_set1_ps(x0);
+        __m256 py = _mm256_set1_ps(y0);
+        __m256 min_d2 = _mm256_set1_ps(c_MinDist2);
+        __m256 max_inv = _mm256_set1_ps(1.0f/c_MinDist);
+        __m256 neg_charge = _mm256_set1_ps(-charge);
+        __m256 neg_max = _mm256_set1_ps(-max_force);
+        __m256 half = _mm256_set1_ps(0.5f);
+        __m256 three_halves = _mm256_set1_ps(1.5f);
+        __m256 sum_x = _mm256_setzero_ps();
+        __m256 sum_y = _mm256_setzero_ps();
+        int i;
+        for (i = 0; i + 8 <= count; i += 8) {
+                __m256 vx = _mm256_sub_ps(_mm256_loadu_ps(&xs[i]), px);
+                __m256 vy = _mm256_sub_ps(_mm256_loadu_ps(&ys[i]), py);
+                __m256 d2 = _mm256_fmadd_ps(vx, vx, _mm256_mul_ps(vy, vy));
+                __m256 close = _mm256_cmp_ps(d2, min_d2, _CMP_LT_OQ);
+                d2 = _mm256_max_ps(d2, min_d2);
+                __m256 inv = _mm256_rsqrt_ps(d2);
+                inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(half, d2), _mm256_mul_ps(inv, inv), three_halves));
+                inv = _mm256_blendv_ps(inv, max_inv, close);
+                __m256 f = _mm256_mul_ps(_mm256_max_ps(_mm256_mul_ps(neg_charge, _mm256_mul_ps(inv, inv)), neg_max), inv);
+                sum_x = _mm256_fmadd_ps(vx, f, sum_x);
+                sum_y = _mm256_fmadd_ps(vy, f, sum_y);
+        }
+        __m128 x4 = _mm_add_ps(_mm256_castps256_ps128(sum_x), _mm256_extractf128_ps(sum_x, 1));
+        __m128 y4 = _mm_add_ps(_mm256_castps256_ps128(sum_y), _mm256_extractf128_ps(sum_y, 1));
+        float lanes_x[4], lanes_y[4];
+        _mm_storeu_ps(lanes_x, x4);
+        _mm_storeu_ps(lanes_y, y4);
+        acc[0] += (lanes_x[0] + lanes_x[1]) + (lanes_x[2] + lanes_x[3]);
+        acc[1] += (lanes_y[0] + lanes_y[1]) + (lanes_y[2] + lanes_y[3]);
+        __repulsion_scalar(x0, y0, &xs[i], &ys[i], count - i, charge, max_force, acc);
+}
+
+__attribute__((target("avx512f")))
+static void __repulsion_avx512(float x0, float y0, const float* xs, const float* ys, int count,
+                               float charge, float max_force, float* acc)
+{
+        __m512 px = _mm512_set1_ps(x0);
+        __m512 py = _mm512_set1_ps(y0);
+        __m512 min_d2 = _mm512_set1_ps(c_MinDist2);
+        __m512 max_inv = _mm512_set1_ps(1.0f/c_MinDist);
+        __m512 neg_charge = _mm512_set1_ps(-charge);
+        __m512 neg_max = _mm512_set1_ps(-max_force);
+        __m512 half = _mm512_set1_ps(0.5f);
+        __m512 three_halves = _mm512_set1_ps(1.5f);
+        __m512 sum_x = _mm512_setzero_ps();
+        __m512 sum_y = _mm512_setzero_ps();
+        int i;
+        for (i = 0; i < count; i += 16) {
+                // the tail is loaded under a mask, its lanes get a zero force
+                __mmask16 mask = count - i >= 16 ? (__mmask16) 0xffff : (__mmask16) ((1u << (count - i)) - 1);
+                __m512 vx = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &xs[i]), px);
+                __m512 vy = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &ys[i]), py);
+                __m512 d2 = _mm512_fmadd_ps(vx, vx, _mm512_mul_ps(vy, vy));
+                __mmask16 close = _mm512_cmp_ps_mask(d2, min_d2, _CMP_LT_OQ);
+                d2 = _mm512_max_ps(d2, min_d2);
+                __m512 inv = _mm512_rsqrt14_ps(d2);
+                inv = _mm512_mul_ps(inv, _mm512_fnmadd_ps(_mm512_mul_ps(half, d2), _mm512_mul_ps(inv, inv), three_halves));
+                inv = _mm512_mask_blend_ps(close, inv, max_inv);
+                __m512 f = _mm512_maskz_mul_ps(mask, _mm512_max_ps(_mm512_mul_ps(neg_charge, _mm512_mul_ps(inv, inv)), neg_max), inv);
+                sum_x = _mm512_fmadd_ps(vx, f, sum_x);
+                sum_y = _mm512_fmadd_ps(vy, f, sum_y);
+        }
+        acc[0] += _mm512_reduce_add_ps(sum_x);
+        acc[1] += _mm512_reduce_add_ps(sum_y);
+}
+
+#endif // USE_X86_KERNELS
+
+static f_Repulsion_Kernel g_kernel = nullptr;
+
+f_Repulsion_Kernel graph_display_kernel_select()
+{
+        if (g_kernel) {
+                return g_kernel;
+        }
+        g_kernel = __repulsion_scalar;
+#ifdef USE_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+                g_kernel = __repulsion_avx512;
+        } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                g_kernel = __repulsion_avx2;
+        } else if (__builtin_cpu_supports("sse2")) {
+                g_kernel = __repulsion_sse;
+        }
+#endif // USE_X86_KERNELS
+        return g_kernel;
+}
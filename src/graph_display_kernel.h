@@ -0,0 +1,14 @@
+#ifndef GRAPH_DISPLAY_KERNEL_H_INCLUDED
+#define GRAPH_DISPLAY_KERNEL_H_INCLUDED
+
+
+// adds the repulsion of the unit mass particles xs/ys[0, count) on the particle at (x0, y0) to acc[0], acc[1].
+// the force is -charge/d^2, limited to max_force, and pairs that nearly coincide get a fixed large push.
+// a particle at (x0, y0) itself contributes nothing, so the kernels can run over ranges that contain it.
+typedef void (*f_Repulsion_Kernel) (float x0, float y0, const float* xs, const float* ys, int count,
+                                    float charge, float max_force, float* acc);
+
+f_Repulsion_Kernel      graph_display_kernel_select();
+
+
+#endif // GRAPH_DISPLAY_KERNEL_H_INCLUDED
@@ -1,25 +1,128 @@
-#include <xercesc/dom/DOM.hpp>
-#include <xercesc/dom/DOMDocument.hpp>
-#include <xercesc/dom/DOMDocumentType.hpp>
-#include <xercesc/dom/DOMElement.hpp>
-#include <xercesc/dom/DOMImplementation.hpp>
-#include <xercesc/dom/DOMImplementationLS.hpp>
-#include <xercesc/dom/DOMNodeIterator.hpp>
-#include <xercesc/dom/DOMNodeList.hpp>
-#include <xercesc/dom/DOMText.hpp>
-
-#include <xercesc/parsers/XercesDOMParser.hpp>
-#include <xercesc/util/XMLUni.hpp>
-#include <xercesc/util/XMLString.hpp>
-#include <xercesc/framework/LocalFileFormatTarget.hpp>
-
-#include <string>
-
-extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
 #include "common.h"
+#include "parallel.h"
 #include "bio_graph.h"
+#include "graph_bgb.h"
 #include "graph_display.h"
 #include "graph_exporter.h"
+
+
+#define c_OutStreamBytes        (1 << 16)
+
+// write-only file with a fixed size buffer in front of it
+struct out_stream {
+        int     fd;
+        char*   buf;
+        size_t  size;
+        bool    failed;
+};
+
+static bool __out_open(struct out_stream* self, const char* filename)
+{
+        self->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (self->fd == -1) {
+                return false;
+        }
+        self->buf       = malloc(c_OutStreamBytes);
+        self->size      = 0;
+        self->failed    = false;
+        return true;
+}
+
+static void __out_flush(struct out_stream* self)
+{
+        const char* p = self->buf;
+        while (self->size > 0 && !self->failed) {
+                ssize_t n = write(self->fd, p, self->size);
+                if (n < 0) {
+                        self->failed = true;
+                } else {
+                        p += n;
+                        self->size -= n;
+                }
+        }
+        self->size = 0;
+}
+
+static void __out_write(struct out_stream* self, const char* data, size_t n)
+{
+        while (n > 0) {
+                if (self->size == c_OutStreamBytes) {
+                        __out_flush(self);
+                }
+                size_t l = MIN(n, c_OutStreamBytes - self->size);
+                memcpy(&self->buf[self->size], data, l);
+                self->size += l;
+                data += l;
+                n -= l;
+        }
+}
+
+static void __out_puts(struct out_stream* self, const char* s)
+{
+        __out_write(self, s, strlen(s));
+}
+
+// room for n more bytes at the end of the buffer, n must not exceed its size
+static char* __out_reserve(struct out_stream* self, size_t n)
+{
+        if (c_OutStreamBytes - self->size < n) {
+                __out_flush(self);
+        }
+        return &self->buf[self->size];
+}
+
+static const char c_DigitPairs[] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+// writes x in decimal at p, two digits at a time, returns the number of characters
+static int __format_int(char* p, int x)
+{
+        char digits[12];
+        char* q = digits + sizeof(digits);
+        unsigned u = x < 0 ? -(unsigned) x : (unsigned) x;
+        while (u >= 100) {
+                q -= 2;
+                memcpy(q, &c_DigitPairs[2*(u % 100)], 2);
+                u /= 100;
+        }
+        if (u >= 10) {
+                q -= 2;
+                memcpy(q, &c_DigitPairs[2*u], 2);
+        } else {
+                *(-- q) = '0' + u;
+        }
+        if (x < 0) {
+                *(-- q) = '-';
+        }
+        int l = digits + sizeof(digits) - q;
+        memcpy(p, q, l);
+        return l;
+}
+
+static void __out_int(struct out_stream* self, int x)
+{
+        char* p = __out_reserve(self, 12);
+        self->size += __format_int(p, x);
+}
+
+// returns false when anything failed to reach the file
+static bool __out_close(struct out_stream* self)
+{
+        __out_flush(self);
+        bool ok = !self->failed;
+        if (close(self->fd) == -1) {
+                ok = false;
+        }
+        free(self->buf);
+        memset(self, 0, sizeof(*self));
+        self->fd = -1;
+        return ok;
 }
 
 bool graph_exporter_write_distri2(const int* collection, const int num_coll, FILE* f)
@@ -33,16 +136,24 @@ bool graph_exporter_write_distri2(const int* collection, const int num_coll, FIL
 
 bool graph_exporter_write_distri(const int* collection, const int num_coll, const char* filename)
 {
-        FILE* fres = fopen(filename, "w+");
-        if (fres == nullptr) {
+        struct out_stream out;
+        if (!__out_open(&out, filename)) {
                 printf("failed to write distribution to the file: %s\n", filename);
                 return false;
         }
-        if (!graph_exporter_write_distri2(collection, num_coll, fres)) {
-                fclose(fres);
+        int i;
+        for (i = 0; i < num_coll; i ++) {
+                char* p = __out_reserve(&out, 32);
+                p += __format_int(p, i);
+                *(p ++) = '\t';
+                p += __format_int(p, collection[i]);
+                *(p ++) = '\n';
+                out.size = p - out.buf;
+        }
+        if (!__out_close(&out)) {
+                printf("failed to write distribution to the file: %s\n", filename);
                 return false;
         }
-        fclose(fres);
         return true;
 }
 
@@ -50,221 +161,706 @@ bool graph_exporter_write_ppm_image(const void* image, const int width, const in
 {
         assert(image);
 
-        const uint8_t* buffer = static_cast<const uint8_t*>(image);
-        FILE *f = fopen(filename, "w+");
-        if (f == nullptr) {
+        // binary P6, the framebuffer stores pixels as b, g, r with ps bytes per pixel
+        const uint8_t* buffer = image;
+        struct out_stream out;
+        if (!__out_open(&out, filename)) {
                 printf("failed to write ppm image to the file: %s\n", filename);
                 return false;
         }
-        fprintf(f, "P3\n%d %d\n%d\n", width, height, 255);
-        int i, j;
+        __out_puts(&out, "P6\n");
+        __out_int(&out, width);
+        __out_puts(&out, " ");
+        __out_int(&out, height);
+        __out_puts(&out, "\n255\n");
+        // rows wider than the stream buffer go out in pieces
+        int i, j, k;
         for (i = 0; i < height; i ++) {
-                for (j = 0; j < width; j ++) {
-                        fprintf(f, "%d %d %d ", buffer[(j + i*width)*ps + 2],
-                                buffer[(j + i*width)*ps + 1],
-                                buffer[(j + i*width)*ps + 0]);
+                const uint8_t* row = &buffer[(size_t) i*width*ps];
+                for (k = 0; k < width; k += c_OutStreamBytes/3) {
+                        int count = MIN(width - k, c_OutStreamBytes/3);
+                        uint8_t* p = (uint8_t*) __out_reserve(&out, 3*count);
+                        for (j = 0; j < count; j ++) {
+                                p[3*j + 0] = row[(k + j)*ps + 2];
+                                p[3*j + 1] = row[(k + j)*ps + 1];
+                                p[3*j + 2] = row[(k + j)*ps + 0];
+                        }
+                        out.size += 3*count;
                 }
         }
-        fclose(f);
+        if (!__out_close(&out)) {
+                printf("failed to write ppm image to the file: %s\n", filename);
+                return false;
+        }
         return true;
 }
 
-static void __txt_write_edge_visitor(const struct bio_graph_vertex* v0, const struct bio_graph_vertex* v1, void* file_ptr)
+// png output: rows are sub filtered and deflated with fixed huffman codes and run
+// length matches (distance 1).  large images are split into bands of rows that are
+// compressed in parallel, every band but the last ends with a sync flush so the
+// pieces concatenate into one zlib stream.
+
+#define c_MinParallelPngRows    256
+#define c_Adler32Base           65521u
+
+struct bit_writer {
+        uint8_t*        bytes;
+        size_t          size;
+        size_t          capacity;
+        uint64_t        bits;
+        int             num_bits;
+};
+
+static void __bits_init(struct bit_writer* self, size_t capacity)
 {
-        fprintf(static_cast<FILE*>(file_ptr), "%d %d\n", bio_graph_vertex_get_id(v0), bio_graph_vertex_get_id(v1));
+        self->capacity  = MAX(capacity, (size_t) 64);
+        self->bytes     = malloc(self->capacity);
+        self->size      = 0;
+        self->bits      = 0;
+        self->num_bits  = 0;
+}
+
+// appends the n low bits of code, least significant bit first
+static void __bits_put(struct bit_writer* self, uint32_t code, int n)
+{
+        self->bits |= (uint64_t) code << self->num_bits;
+        self->num_bits += n;
+        if (self->num_bits >= 32) {
+                if (self->size + 4 > self->capacity) {
+                        self->capacity *= 2;
+                        self->bytes = realloc(self->bytes, self->capacity);
+                }
+                self->bytes[self->size ++] = self->bits;
+                self->bytes[self->size ++] = self->bits >> 8;
+                self->bytes[self->size ++] = self->bits >> 16;
+                self->bytes[self->size ++] = self->bits >> 24;
+                self->bits >>= 32;
+                self->num_bits -= 32;
+        }
+}
+
+// pads to a byte boundary and moves the pending bits out
+static void __bits_align(struct bit_writer* self)
+{
+        __bits_put(self, 0, (8 - self->num_bits % 8) % 8);
+        if (self->size + 4 > self->capacity) {
+                self->capacity *= 2;
+                self->bytes = realloc(self->bytes, self->capacity);
+        }
+        while (self->num_bits > 0) {
+                self->bytes[self->size ++] = self->bits;
+                self->bits >>= 8;
+                self->num_bits -= 8;
+        }
+}
+
+static uint32_t __reverse_bits(uint32_t code, int n)
+{
+        uint32_t r = 0;
+        int i;
+        for (i = 0; i < n; i ++) {
+                r = (r << 1) | ((code >> i) & 1);
+        }
+        return r;
+}
+
+// fixed huffman code of a literal/length symbol, already bit reversed for __bits_put
+static void __deflate_put_symbol(struct bit_writer* self, int sym)
+{
+        if (sym < 144) {
+                __bits_put(self, __reverse_bits(0x30 + sym, 8), 8);
+        } else if (sym < 256) {
+                __bits_put(self, __reverse_bits(0x190 + sym - 144, 9), 9);
+        } else if (sym < 280) {
+                __bits_put(self, __reverse_bits(sym - 256, 7), 7);
+        } else {
+                __bits_put(self, __reverse_bits(0xc0 + sym - 280, 8), 8);
+        }
+}
+
+static const int c_LengthBase[] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const int c_LengthExtra[] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+// a copy of the previous byte repeated len times, 3 <= len <= 258
+static void __deflate_put_run(struct bit_writer* self, int len)
+{
+        int c = 28;
+        while (c_LengthBase[c] > len) {
+                c --;
+        }
+        __deflate_put_symbol(self, 257 + c);
+        if (c_LengthExtra[c] > 0) {
+                __bits_put(self, len - c_LengthBase[c], c_LengthExtra[c]);
+        }
+        // distance code 0 (distance 1), five zero bits
+        __bits_put(self, 0, 5);
+}
+
+// one fixed huffman block over data, final or followed by an empty stored block
+static void __deflate_fixed(struct bit_writer* self, const uint8_t* data, size_t size, bool final)
+{
+        __bits_put(self, final ? 1 : 0, 1);
+        __bits_put(self, 1, 2);
+        size_t i = 0;
+        while (i < size) {
+                size_t run = 0;
+                if (i > 0) {
+                        while (run < 258 && i + run < size && data[i + run] == data[i - 1]) {
+                                run ++;
+                        }
+                }
+                if (run >= 3) {
+                        __deflate_put_run(self, run);
+                        i += run;
+                } else {
+                        __deflate_put_symbol(self, data[i ++]);
+                }
+        }
+        __deflate_put_symbol(self, 256);
+        if (!final) {
+                // sync flush: empty stored block, byte aligned
+                __bits_put(self, 0, 3);
+                __bits_align(self);
+                __bits_put(self, 0xffff0000, 32);
+        }
+        __bits_align(self);
+}
+
+static uint32_t __adler32(const uint8_t* data, size_t size)
+{
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+                // 5552 bytes keep b below 2^32 before it has to be reduced
+                size_t n = MIN(size, (size_t) 5552);
+                size_t i;
+                for (i = 0; i < n; i ++) {
+                        a += data[i];
+                        b += a;
+                }
+                a %= c_Adler32Base;
+                b %= c_Adler32Base;
+                data += n;
+                size -= n;
+        }
+        return (b << 16) | a;
+}
+
+// adler-32 of two concatenated pieces, len2 is the size of the second one
+static uint32_t __adler32_combine(uint32_t adler1, uint32_t adler2, size_t len2)
+{
+        uint32_t rem = len2 % c_Adler32Base;
+        uint32_t a1 = adler1 & 0xffff, b1 = adler1 >> 16;
+        uint32_t a2 = adler2 & 0xffff, b2 = adler2 >> 16;
+        uint32_t a = (a1 + a2 + c_Adler32Base - 1) % c_Adler32Base;
+        uint32_t b = (uint32_t) (((uint64_t) rem*a1 + b1 + b2 + c_Adler32Base - rem) % c_Adler32Base);
+        return (b << 16) | a;
+}
+
+static uint32_t c_Crc32Table[256];
+
+static void __crc32_init_table()
+{
+        if (c_Crc32Table[1] != 0) {
+                return ;
+        }
+        uint32_t n;
+        for (n = 0; n < 256; n ++) {
+                uint32_t c = n;
+                int k;
+                for (k = 0; k < 8; k ++) {
+                        c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                c_Crc32Table[n] = c;
+        }
+}
+
+static uint32_t __crc32_update(uint32_t crc, const uint8_t* data, size_t size)
+{
+        crc = ~crc;
+        size_t i;
+        for (i = 0; i < size; i ++) {
+                crc = c_Crc32Table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+}
+
+static void __out_be32(struct out_stream* self, uint32_t x)
+{
+        char b[4] = {(char) (x >> 24), (char) (x >> 16), (char) (x >> 8), (char) x};
+        __out_write(self, b, 4);
+}
+
+static void __png_write_chunk(struct out_stream* out, const char* type, const uint8_t* data, size_t size)
+{
+        __out_be32(out, size);
+        __out_write(out, type, 4);
+        __out_write(out, (const char*) data, size);
+        uint32_t crc = __crc32_update(0, (const uint8_t*) type, 4);
+        __out_be32(out, __crc32_update(crc, data, size));
+}
+
+struct png_band_pack {
+        const uint8_t*          image;
+        int                     width;
+        int                     height;
+        int                     ps;
+        struct bit_writer*      bands;
+        uint32_t*               adlers;
+        size_t*                 raw_sizes;
+};
+
+static void __png_band_task(int thread_id, int num_threads, void* user_data)
+{
+        struct png_band_pack* pack = user_data;
+        int row_start = (long) pack->height*thread_id/num_threads;
+        int row_end = (long) pack->height*(thread_id + 1)/num_threads;
+        size_t row_size = 1 + 3*(size_t) pack->width;
+        size_t raw_size = row_size*(row_end - row_start);
+        uint8_t* raw = malloc(MAX(raw_size, (size_t) 1));
+        int i, j;
+        for (i = row_start; i < row_end; i ++) {
+                const uint8_t* src = &pack->image[(size_t) i*pack->width*pack->ps];
+                uint8_t* dst = &raw[(i - row_start)*row_size];
+                // sub filter: every byte minus the same channel of the pixel on its left
+                dst[0] = 1;
+                uint8_t left[3] = {0, 0, 0};
+                for (j = 0; j < pack->width; j ++) {
+                        uint8_t rgb[3] = {src[j*pack->ps + 2], src[j*pack->ps + 1], src[j*pack->ps + 0]};
+                        dst[1 + 3*j + 0] = rgb[0] - left[0];
+                        dst[1 + 3*j + 1] = rgb[1] - left[1];
+                        dst[1 + 3*j + 2] = rgb[2] - left[2];
+                        memcpy(left, rgb, 3);
+                }
+        }
+        struct bit_writer* band = &pack->bands[thread_id];
+        __bits_init(band, raw_size/4);
+        __deflate_fixed(band, raw, raw_size, thread_id == num_threads - 1);
+        pack->adlers[thread_id] = __adler32(raw, raw_size);
+        pack->raw_sizes[thread_id] = raw_size;
+        free(raw);
+}
+
+bool graph_exporter_write_png_image(const void* image, const int width, const int height, const int ps, const char* filename)
+{
+        assert(image);
+
+        struct out_stream out;
+        if (!__out_open(&out, filename)) {
+                printf("failed to write png image to the file: %s\n", filename);
+                return false;
+        }
+        __crc32_init_table();
+        int num_threads = height >= c_MinParallelPngRows ? MIN(parallel_get_num_threads(), height/64) : 1;
+        num_threads = MAX(1, num_threads);
+        struct png_band_pack pack;
+        pack.image      = image;
+        pack.width      = width;
+        pack.height     = height;
+        pack.ps         = ps;
+        pack.bands      = malloc(sizeof(*pack.bands)*num_threads);
+        pack.adlers     = malloc(sizeof(*pack.adlers)*num_threads);
+        pack.raw_sizes  = malloc(sizeof(*pack.raw_sizes)*num_threads);
+        parallel_run(num_threads, __png_band_task, &pack);
+
+        __out_write(&out, "\x89PNG\r\n\x1a\n", 8);
+        // 8 bit rgb, no interlacing
+        uint8_t ihdr[13] = {
+                width >> 24, width >> 16, width >> 8, width,
+                height >> 24, height >> 16, height >> 8, height,
+                8, 2, 0, 0, 0
+        };
+        __png_write_chunk(&out, "IHDR", ihdr, sizeof(ihdr));
+        // every band goes out as its own IDAT, the zlib header and the checksum as two more
+        const uint8_t zlib_header[2] = {0x78, 0x01};
+        __png_write_chunk(&out, "IDAT", zlib_header, sizeof(zlib_header));
+        uint32_t adler = 1;
+        int t;
+        for (t = 0; t < num_threads; t ++) {
+                __png_write_chunk(&out, "IDAT", pack.bands[t].bytes, pack.bands[t].size);
+                adler = __adler32_combine(adler, pack.adlers[t], pack.raw_sizes[t]);
+                free(pack.bands[t].bytes);
+        }
+        const uint8_t zlib_trailer[4] = {adler >> 24, adler >> 16, adler >> 8, adler};
+        __png_write_chunk(&out, "IDAT", zlib_trailer, sizeof(zlib_trailer));
+        __png_write_chunk(&out, "IEND", nullptr, 0);
+        free(pack.bands);
+        free(pack.adlers);
+        free(pack.raw_sizes);
+
+        if (!__out_close(&out)) {
+                printf("failed to write png image to the file: %s\n", filename);
+                return false;
+        }
+        return true;
+}
+
+// writes every undirected edge once, from the row of its smaller end, as
+// "<v + id_base> <w + id_base><suffix>"
+static void __write_edge_lines(struct out_stream* out, const struct bio_graph* self, int id_base, const char* suffix)
+{
+        const int* row_offsets;
+        const int* col_ids;
+        bio_graph_get_csr(self, &row_offsets, &col_ids);
+        size_t suffix_len = strlen(suffix);
+        int num_verts = bio_graph_get_vertex_num(self);
+        int v, k;
+        for (v = 0; v < num_verts; v ++) {
+                char v_digits[12];
+                int v_len = __format_int(v_digits, v + id_base);
+                for (k = row_offsets[v]; k < row_offsets[v + 1]; k ++) {
+                        int w = col_ids[k];
+                        if (v >= w) {
+                                continue;
+                        }
+                        char* p = __out_reserve(out, 2*12 + suffix_len);
+                        memcpy(p, v_digits, v_len);
+                        p += v_len;
+                        *(p ++) = ' ';
+                        p += __format_int(p, w + id_base);
+                        memcpy(p, suffix, suffix_len);
+                        p += suffix_len;
+                        out->size = p - out->buf;
+                }
+        }
 }
 
 bool graph_exporter_write_txt_file(const struct bio_graph* self, const char* filename)
 {
         assert(self);
 
-        FILE *f = fopen(filename, "w+");
-        if (f == nullptr) {
+        struct out_stream out;
+        if (!__out_open(&out, filename)) {
+                printf("failed to write graph to the file: %s\n", filename);
+                return false;
+        }
+        __out_int(&out, bio_graph_get_vertex_num(self));
+        __out_puts(&out, "\n");
+        __write_edge_lines(&out, self, 0, "\n");
+        if (!__out_close(&out)) {
                 printf("failed to write graph to the file: %s\n", filename);
                 return false;
         }
-        fprintf(f, "%d\n", bio_graph_get_vertex_num(self));
-        bio_graph_visit_edges(self, __txt_write_edge_visitor, f);
-        fclose(f);
         return true;
 }
 
-class GEXFContext
+// gexf, gw and layout files spell an unnamed vertex as its numeric id, and their readers look a
+// token up as a name before they take it for an id. a vertex named like the id of an unnamed one
+// would swallow it on the way back in, so such graphs are not written
+static bool __check_unnamed_spelling(const struct bio_graph* self, const char* filename)
 {
-public:
-        GEXFContext(xercesc::DOMElement* container, xercesc::DOMDocument* doc) : m_doc(doc), m_container(container)
-        {}
-
-        xercesc::DOMDocument* get_document()
-        {
-                return m_doc;
+        int n = bio_graph_get_vertex_num(self);
+        int v;
+        for (v = 0; v < n; v ++) {
+                if (bio_graph_get_vertex_name(self, v) != nullptr) {
+                        continue;
+                }
+                char id[12];
+                id[__format_int(id, v)] = '\0';
+                int named = bio_graph_find_vertex_by_name(self, id);
+                if (named != -1) {
+                        printf("cannot write %s: vertex %d is named like unnamed vertex %d\n", filename, named, v);
+                        return false;
+                }
         }
+        return true;
+}
 
-        xercesc::DOMElement* get_container()
-        {
-                return m_container;
+// writes s as xml attribute text, only names that need escaping take the slow path
+static void __gexf_write_escaped(struct out_stream* out, const char* s)
+{
+        const char* run = s;
+        for (; *s != '\0'; s ++) {
+                const char* entity;
+                switch (*s) {
+                case '&': entity = "&amp;"; break;
+                case '<': entity = "&lt;"; break;
+                case '>': entity = "&gt;"; break;
+                case '"': entity = "&quot;"; break;
+                default: continue;
+                }
+                __out_write(out, run, s - run);
+                __out_puts(out, entity);
+                run = s + 1;
         }
+        __out_write(out, run, s - run);
+}
 
-        int next_global_edge_count()
-        {
-                return m_glb_edges_count ++;
+// the vertex name when the graph carries one, otherwise its numeric id
+static void __gexf_write_vertex_name(struct out_stream* out, const struct bio_graph* self, int v)
+{
+        const char* name = bio_graph_get_vertex_name(self, v);
+        if (name) {
+                __gexf_write_escaped(out, name);
+        } else {
+                __out_int(out, v);
         }
-private:
-        xercesc::DOMDocument*   m_doc;
-        xercesc::DOMElement*    m_container;
-        int                     m_glb_edges_count = 0;
-};
+}
 
-static void __gexf_write_node_visitor(const struct bio_graph_vertex* v, void* data)
+bool graph_exporter_write_gexf_file(const struct bio_graph* self, const char* filename)
 {
-        int vid = bio_graph_vertex_get_id(v);
+        assert(self);
+
+        if (!__check_unnamed_spelling(self, filename)) {
+                return false;
+        }
 
-        GEXFContext* gexfctx = static_cast<GEXFContext*>(data);
+        struct out_stream out;
+        if (!__out_open(&out, filename)) {
+                printf("failed to write graph to the file: %s\n", filename);
+                return false;
+        }
+        __out_puts(&out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                         "<gexf xmlns=\"http://www.gexf.net/1.1draft\" version=\"1.1\">\n"
+                         "  <graph defaultedgetype=\"undirected\" mode=\"static\">\n"
+                         "    <attributes class=\"node\" mode=\"static\">\n"
+                         "      <attribute id=\"0\" title=\"gname\" type=\"string\" />\n"
+                         "    </attributes>\n");
+
+        // node section
         // <node id="Q8L765" label="Q8L765">
         //  <attvalues>
         //   <attvalue for="0" value="Q8L765" />
         //  </attvalues>
         // </node>
-        xercesc::DOMElement* node = gexfctx->get_document()->createElement(xercesc::XMLString::transcode("node"));
-        node->setAttribute(xercesc::XMLString::transcode("id"),
-                           xercesc::XMLString::transcode(std::to_string(vid).c_str()));
-        node->setAttribute(xercesc::XMLString::transcode("label"),
-                           xercesc::XMLString::transcode(std::to_string(vid).c_str()));
-
-        xercesc::DOMElement* node_attrs = gexfctx->get_document()->createElement(xercesc::XMLString::transcode("attributes"));
-        xercesc::DOMElement* node_attr = gexfctx->get_document()->createElement(xercesc::XMLString::transcode("attribute"));
-        node_attr->setAttribute(xercesc::XMLString::transcode("for"), xercesc::XMLString::transcode("0"));
-        node_attr->setAttribute(xercesc::XMLString::transcode("value"),
-                                xercesc::XMLString::transcode(std::to_string(vid).c_str()));
-        node_attrs->appendChild(node_attr);
-        node->appendChild(node_attrs);
-        gexfctx->get_container()->appendChild(node);
-}
-
-static void __gexf_write_edge_visitor(const struct bio_graph_vertex* v0, const struct bio_graph_vertex* v1, void* data)
-{
-        int v0id = bio_graph_vertex_get_id(v0);
-        int v1id = bio_graph_vertex_get_id(v1);
-
-        GEXFContext* gexfctx = static_cast<GEXFContext*>(data);
-        // <edge id="0" source="Q8L765" target="Q94B33" weight="1.1" />
-        xercesc::DOMElement* edge = gexfctx->get_document()->createElement(xercesc::XMLString::transcode("edge"));
-        edge->setAttribute(xercesc::XMLString::transcode("id"),
-                           xercesc::XMLString::transcode(std::to_string(gexfctx->next_global_edge_count()).c_str()));
-        edge->setAttribute(xercesc::XMLString::transcode("source"),
-                           xercesc::XMLString::transcode(std::to_string(v0id).c_str()));
-        edge->setAttribute(xercesc::XMLString::transcode("target"),
-                           xercesc::XMLString::transcode(std::to_string(v1id).c_str()));
-        edge->setAttribute(xercesc::XMLString::transcode("weight"),
-                           xercesc::XMLString::transcode("1.0"));
-        gexfctx->get_container()->appendChild(edge);
+        __out_puts(&out, "    <nodes>\n");
+        int num_verts = bio_graph_get_vertex_num(self);
+        int v;
+        for (v = 0; v < num_verts; v ++) {
+                __out_puts(&out, "      <node id=\"");
+                __gexf_write_vertex_name(&out, self, v);
+                __out_puts(&out, "\" label=\"");
+                __gexf_write_vertex_name(&out, self, v);
+                __out_puts(&out, "\">\n        <attvalues>\n          <attvalue for=\"0\" value=\"");
+                __gexf_write_vertex_name(&out, self, v);
+                __out_puts(&out, "\" />\n        </attvalues>\n      </node>\n");
+        }
+        __out_puts(&out, "    </nodes>\n");
+
+        // edge section, each undirected edge once from the row of its smaller end
+        // <edge id="0" source="Q8L765" target="Q94B33" weight="1.0" />
+        __out_puts(&out, "    <edges>\n");
+        const int* row_offsets;
+        const int* col_ids;
+        bio_graph_get_csr(self, &row_offsets, &col_ids);
+        int num_edges = 0;
+        int k;
+        for (v = 0; v < num_verts; v ++) {
+                for (k = row_offsets[v]; k < row_offsets[v + 1]; k ++) {
+                        int w = col_ids[k];
+                        if (v >= w) {
+                                continue;
+                        }
+                        __out_puts(&out, "      <edge id=\"");
+                        __out_int(&out, num_edges ++);
+                        __out_puts(&out, "\" source=\"");
+                        __gexf_write_vertex_name(&out, self, v);
+                        __out_puts(&out, "\" target=\"");
+                        __gexf_write_vertex_name(&out, self, w);
+                        __out_puts(&out, "\" weight=\"1.0\" />\n");
+                }
+        }
+        __out_puts(&out, "    </edges>\n  </graph>\n</gexf>\n");
+
+        if (!__out_close(&out)) {
+                printf("failed to write graph to the file: %s\n", filename);
+                return false;
+        }
+        return true;
 }
 
-bool graph_exporter_write_gexf_file(const struct bio_graph* self, const char* filename)
+bool graph_exporter_write_gw_file(const struct bio_graph* self, const char* filename)
 {
         assert(self);
 
-        try {
-                xercesc::XMLPlatformUtils::Initialize();
-        } catch (const xercesc::XMLException& toCatch) {
-                printf("failed to initiailze xercesc\n");
+        // gw has no escapes, and the reader splits the file into lines and skips the ones holding a '#'
+        int num_verts = bio_graph_get_vertex_num(self);
+        int i;
+        for (i = 0; i < num_verts; i ++) {
+                const char* name = bio_graph_get_vertex_name(self, i);
+                if (name && strpbrk(name, "\r\n#")) {
+                        printf("failed to write graph to the file: %s vertex name %d cannot be stored in gw\n",
+                               filename, i);
+                        return false;
+                }
+        }
+        if (!__check_unnamed_spelling(self, filename)) {
                 return false;
         }
 
-
-        xercesc::DOMImplementation* impl = xercesc::DOMImplementationRegistry::getDOMImplementation(
-                        xercesc::XMLString::transcode("LS"));
+        struct out_stream out;
+        if (!__out_open(&out, filename)) {
+                printf("failed to write graph to the file: %s\n", filename);
+                return false;
+        }
         // write header
-        xercesc::DOMDocument* doc = impl->createDocument();
-        xercesc::DOMElement* gexf_header = doc->createElement(xercesc::XMLString::transcode("gexf"));
-        gexf_header->setAttribute(xercesc::XMLString::transcode("xmlns"),
-                                  xercesc::XMLString::transcode("http://www.gexf.net/1.1draft"));
-        gexf_header->setAttribute(xercesc::XMLString::transcode("version"),
-                                  xercesc::XMLString::transcode("1.1"));
-        doc->appendChild(gexf_header);
-        // <graph defaultedgetype="undirected" mode="static">
-        xercesc::DOMElement* graph_elm = doc->createElement(xercesc::XMLString::transcode("graph"));
-        graph_elm->setAttribute(xercesc::XMLString::transcode("defaultedgetype"), xercesc::XMLString::transcode("undirected"));
-        graph_elm->setAttribute(xercesc::XMLString::transcode("mode"), xercesc::XMLString::transcode("static"));
-        gexf_header->appendChild(graph_elm);
-        // <attributes class="node" mode="static">
-        //  <attribute id="0" title="gname" type="string" />
-        // </attributes>
-        xercesc::DOMElement* attris = doc->createElement(xercesc::XMLString::transcode("attributes"));
-        attris->setAttribute(xercesc::XMLString::transcode("class"), xercesc::XMLString::transcode("node"));
-        attris->setAttribute(xercesc::XMLString::transcode("mode"), xercesc::XMLString::transcode("static"));
-        graph_elm->appendChild(attris);
-        xercesc::DOMElement* attri0 = doc->createElement(xercesc::XMLString::transcode("attribute"));
-        attri0->setAttribute(xercesc::XMLString::transcode("id"), xercesc::XMLString::transcode("0"));
-        attri0->setAttribute(xercesc::XMLString::transcode("title"), xercesc::XMLString::transcode("gname"));
-        attri0->setAttribute(xercesc::XMLString::transcode("type"), xercesc::XMLString::transcode("string"));
-        attris->appendChild(attri0);
+        __out_puts(&out, "LEDA.GRAPH\nstring\nint\n-2\n");
 
         // node section
-        xercesc::DOMElement* nodes = doc->createElement(xercesc::XMLString::transcode("nodes"));
-        GEXFContext node_ctx(nodes, doc);
-        bio_graph_visit_vertices(self, __gexf_write_node_visitor, &node_ctx);
-        graph_elm->appendChild(nodes);
+        __out_int(&out, num_verts);
+        __out_puts(&out, "\n");
+        for (i = 0; i < num_verts; i ++) {
+                const char* name = bio_graph_get_vertex_name(self, i);
+                __out_puts(&out, "|{");
+                if (name) {
+                        __out_puts(&out, name);
+                } else {
+                        __out_int(&out, i);
+                }
+                __out_puts(&out, "}|\n");
+        }
 
         // edge section
-        xercesc::DOMElement* edges = doc->createElement(xercesc::XMLString::transcode("edges"));
-        GEXFContext edge_ctx(edges, doc);
-        bio_graph_visit_edges(self, __gexf_write_edge_visitor, &edge_ctx);
-        graph_elm->appendChild(edges);
+        __out_int(&out, bio_graph_get_edge_num(self));
+        __out_puts(&out, "\n");
+        __write_edge_lines(&out, self, 1, " 0 |{}|\n");
+        if (!__out_close(&out)) {
+                printf("failed to write graph to the file: %s\n", filename);
+                return false;
+        }
+        return true;
+}
 
-        // serialize the DOM tree
-        xercesc::XMLFormatTarget* file_target = new xercesc::LocalFileFormatTarget(xercesc::XMLString::transcode(filename));
-        xercesc::DOMLSOutput* output_desc = ((xercesc::DOMImplementationLS*) impl)->createLSOutput();
-        output_desc->setByteStream(file_target);
 
-        xercesc::DOMLSSerializer* serializer = ((xercesc::DOMImplementationLS*) impl)->createLSSerializer();
-        if (serializer->getDomConfig()->canSetParameter(xercesc::XMLUni::fgDOMWRTFormatPrettyPrint, true))
-                serializer->getDomConfig()->setParameter(xercesc::XMLUni::fgDOMWRTFormatPrettyPrint, true);
-        serializer->write(doc, output_desc);
+bool graph_exporter_write_bgb_file(const struct bio_graph* self, const char* filename)
+{
+        assert(self);
 
-        delete file_target;
-        xercesc::XMLPlatformUtils::Terminate();
-        return false;
-}
+        const int* row_offsets;
+        const int* col_ids;
+        bio_graph_get_csr(self, &row_offsets, &col_ids);
+        int num_verts = bio_graph_get_vertex_num(self);
 
-static void __edge_count_visitor(const struct bio_graph_vertex* v0, const struct bio_graph_vertex* v1, void* edge_num)
-{
-        (*static_cast<int*>(edge_num)) ++;
+        // gather the names into one zero padded pool
+        size_t pool_size = 0;
+        int i;
+        for (i = 0; i < num_verts; i ++) {
+                const char* name = bio_graph_get_vertex_name(self, i);
+                if (name) {
+                        pool_size += strlen(name) + 1;
+                }
+        }
+        int* name_offsets = nullptr;
+        char* pool = nullptr;
+        if (pool_size > 0) {
+                name_offsets = malloc(sizeof(*name_offsets)*num_verts);
+                pool = calloc(bgb_padded_pool_size(pool_size), 1);
+                size_t offset = 0;
+                for (i = 0; i < num_verts; i ++) {
+                        const char* name = bio_graph_get_vertex_name(self, i);
+                        if (name) {
+                                size_t l = strlen(name) + 1;
+                                memcpy(&pool[offset], name, l);
+                                name_offsets[i] = offset;
+                                offset += l;
+                        } else {
+                                name_offsets[i] = -1;
+                        }
+                }
+        }
+
+        struct bgb_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, c_BgbMagic, sizeof(header.magic));
+        header.endian_tag       = c_BgbEndianTag;
+        header.version          = c_BgbVersion;
+        header.num_verts        = num_verts;
+        header.num_entries      = row_offsets[num_verts];
+        header.name_pool_size   = pool_size;
+
+        // every section is in memory already, so the checksum is known before the header goes out
+        size_t pool_words = bgb_padded_pool_size(pool_size)/sizeof(uint32_t);
+        struct bgb_checksum checksum;
+        bgb_checksum_init(&checksum);
+        bgb_checksum_update(&checksum, (const uint32_t*) row_offsets, num_verts + 1, false);
+        bgb_checksum_update(&checksum, (const uint32_t*) col_ids, header.num_entries, false);
+        if (pool_size > 0) {
+                bgb_checksum_update(&checksum, (const uint32_t*) name_offsets, num_verts, false);
+                bgb_checksum_update(&checksum, (const uint32_t*) pool, pool_words, false);
+        }
+        header.checksum = bgb_checksum_get(&checksum);
+
+        struct out_stream out;
+        if (!__out_open(&out, filename)) {
+                printf("failed to write graph to the file: %s\n", filename);
+                free(name_offsets);
+                free(pool);
+                return false;
+        }
+        __out_write(&out, (const char*) &header, sizeof(header));
+        __out_write(&out, (const char*) row_offsets, sizeof(*row_offsets)*(num_verts + 1));
+        __out_write(&out, (const char*) col_ids, sizeof(*col_ids)*header.num_entries);
+        if (pool_size > 0) {
+                __out_write(&out, (const char*) name_offsets, sizeof(*name_offsets)*num_verts);
+                __out_write(&out, pool, sizeof(uint32_t)*pool_words);
+        }
+        free(name_offsets);
+        free(pool);
+        if (!__out_close(&out)) {
+                printf("failed to write graph to the file: %s\n", filename);
+                return false;
+        }
+        return true;
 }
 
-static void __gw_edge_writer_visitor(const struct bio_graph_vertex* v0, const struct bio_graph_vertex* v1, void* file_ptr)
+// tabs and line breaks separate the fields of a layout file, so names escape them and the backslash
+static void __out_layout_name(struct out_stream* out, const char* name)
 {
-        fprintf(static_cast<FILE*>(file_ptr), "%d %d 0 |{}|\n", bio_graph_vertex_get_id(v0) + 1, bio_graph_vertex_get_id(v1) + 1);
+        const char* s = name;
+        for (; *name; name ++) {
+                const char* escape;
+                switch (*name) {
+                case '\t': escape = "\\t"; break;
+                case '\n': escape = "\\n"; break;
+                case '\r': escape = "\\r"; break;
+                case '\\': escape = "\\\\"; break;
+                default: continue;
+                }
+                __out_write(out, s, name - s);
+                __out_puts(out, escape);
+                s = name + 1;
+        }
+        __out_write(out, s, name - s);
 }
 
-bool graph_exporter_write_gw_file(const struct bio_graph* self, const char* filename)
+// layout sidecar: the vertex count, then one "name<tab>x<tab>y" line per vertex. unnamed vertices
+// are written under their numeric id, which no other vertex may carry as its name
+bool graph_exporter_write_layout_file(const struct bio_graph* self, const float* pos_x, const float* pos_y,
+                                      const char* filename)
 {
         assert(self);
 
-        FILE* f;
-        f = fopen(filename, "w+");
-        if (f == nullptr) {
-                printf("failed to write graph to the file: %s\n", filename);
+        if (!__check_unnamed_spelling(self, filename)) {
                 return false;
         }
-        // write header
-        fprintf(f, "LEDA.GRAPH\n");
-        fprintf(f, "string\n");
-        fprintf(f, "int\n");
-        fprintf(f, "-2\n");
 
-        // node section
-        fprintf(f, "%d\n", bio_graph_get_vertex_num(self));
-        int i;
-        for (i = 0; i < bio_graph_get_vertex_num(self); i ++) {
-                fprintf(f, "|{%d}|\n", i);
+        struct out_stream out;
+        if (!__out_open(&out, filename)) {
+                printf("failed to write layout to the file: %s\n", filename);
+                return false;
+        }
+        int n = bio_graph_get_vertex_num(self);
+        __out_int(&out, n);
+        __out_puts(&out, "\n");
+        int v;
+        for (v = 0; v < n; v ++) {
+                const char* name = bio_graph_get_vertex_name(self, v);
+                if (name) {
+                        __out_layout_name(&out, name);
+                } else {
+                        __out_int(&out, v);
+                }
+                char* p = __out_reserve(&out, 64);
+                out.size += snprintf(p, 64, "\t%.9g\t%.9g\n", pos_x[v], pos_y[v]);
+        }
+        if (!__out_close(&out)) {
+                printf("failed to write layout to the file: %s\n", filename);
+                return false;
         }
-
-        // edge section
-        int num_edge = 0;
-        bio_graph_visit_edges(self, __edge_count_visitor, &num_edge);
-        fprintf(f, "%d\n", num_edge);
-        bio_graph_visit_edges(self, __gw_edge_writer_visitor, f);
-        fclose(f);
         return true;
 }
@@ -1,67 +1,471 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "common.h"
+#include "parallel.h"
 #include "bio_graph.h"
+#include "graph_bgb.h"
 #include "graph_importer.h"
 
 
-#define c_MaxLineLength         256
+struct edge_batch {
+        int*    edges;
+        int     num_edges;
+        int     capacity;
+};
+
+static void __batch_init(struct edge_batch* self)
+{
+        self->capacity  = 1024;
+        self->num_edges = 0;
+        self->edges     = malloc(sizeof(*self->edges)*2*self->capacity);
+}
+
+static void __batch_free(struct edge_batch* self)
+{
+        free(self->edges);
+        memset(self, 0, sizeof(*self));
+}
+
+static void __batch_reserve(struct edge_batch* self, int num_edges)
+{
+        if (num_edges > self->capacity) {
+                self->capacity = num_edges;
+                self->edges = realloc(self->edges, sizeof(*self->edges)*2*self->capacity);
+        }
+}
+
+static void __batch_push(struct edge_batch* self, int v0, int v1)
+{
+        if (self->num_edges == self->capacity) {
+                self->capacity *= 2;
+                self->edges = realloc(self->edges, sizeof(*self->edges)*2*self->capacity);
+        }
+        self->edges[2*self->num_edges + 0] = v0;
+        self->edges[2*self->num_edges + 1] = v1;
+        self->num_edges ++;
+}
+
+// the whole file mapped read-only, text loaders scan it in place
+struct mapped_file {
+        const char*     data;
+        size_t          size;
+};
+
+static bool __map_file(struct mapped_file* self, const char* filename)
+{
+        int fd = open(filename, O_RDONLY);
+        if (fd == -1) {
+                return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+                close(fd);
+                return false;
+        }
+        self->size = st.st_size;
+        self->data = "";
+        if (self->size > 0) {
+                void* data = mmap(nullptr, self->size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data == MAP_FAILED) {
+                        close(fd);
+                        return false;
+                }
+                madvise(data, self->size, MADV_SEQUENTIAL);
+                self->data = data;
+        }
+        close(fd);
+        return true;
+}
+
+static void __unmap_file(struct mapped_file* self)
+{
+        if (self->size > 0) {
+                munmap((void*) self->data, self->size);
+        }
+        memset(self, 0, sizeof(*self));
+}
+
+// cuts [*p, end) at the next newline, returns false when nothing is left
+static bool __next_line(const char** p, const char* end, const char** line, const char** line_end)
+{
+        if (*p >= end) {
+                return false;
+        }
+        const char* nl = memchr(*p, '\n', end - *p);
+        *line = *p;
+        *line_end = nl ? nl : end;
+        *p = nl ? nl + 1 : end;
+        return true;
+}
+
+static bool __is_space(char c)
+{
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// locale free decimal scanner, leading blanks are skipped
+static const char* __scan_int(const char* p, const char* end, int* value, bool* ok)
+{
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p ++;
+        bool negative = p < end && *p == '-';
+        p += negative;
+        const char* digits = p;
+        unsigned v = 0;
+        while (p < end && (unsigned) (*p - '0') < 10) {
+                v = v*10 + (unsigned) (*p - '0');
+                p ++;
+        }
+        *ok = p != digits;
+        *value = negative ? -(int) v : (int) v;
+        return p;
+}
+
+// lines holding at least two integers become edges, id_base is subtracted from both ends
+static void __scan_edge_lines(const char* p, const char* end, int id_base, struct edge_batch* batch)
+{
+        const char* line;
+        const char* line_end;
+        while (__next_line(&p, end, &line, &line_end)) {
+                int v0, v1;
+                bool ok0, ok1;
+                const char* q = __scan_int(line, line_end, &v0, &ok0);
+                __scan_int(q, line_end, &v1, &ok1);
+                if (ok0 & ok1) {
+                        __batch_push(batch, v0 - id_base, v1 - id_base);
+                }
+        }
+}
+
+// txt edges are pairs of integers separated by any whitespace, line breaks included, and tokens
+// that are not integers are skipped. a chunk may end between the two ends of an edge, the end left
+// over goes to *odd and true is returned then
+static bool __scan_edge_tokens(const char* p, const char* end, int id_base, struct edge_batch* batch, int* odd)
+{
+        bool pending = false;
+        int v0 = 0;
+        while (true) {
+                while (p < end && __is_space(*p)) p ++;
+                if (p == end) {
+                        break;
+                }
+                int v;
+                bool ok;
+                const char* q = __scan_int(p, end, &v, &ok);
+                if (!ok || (q < end && !__is_space(*q))) {
+                        while (p < end && !__is_space(*p)) p ++;
+                        continue;
+                }
+                p = q;
+                if (pending) {
+                        __batch_push(batch, v0 - id_base, v - id_base);
+                } else {
+                        v0 = v;
+                }
+                pending = !pending;
+        }
+        *odd = v0 - id_base;
+        return pending;
+}
+
+struct scan_pack {
+        const char*                     data;
+        const char*                     end;
+        int                             id_base;
+        bool                            by_token;
+        struct edge_batch*              batches;
+        int*                            odd;            // end left over by each chunk in token mode
+        bool*                           has_odd;
+};
+
+// a chunk starts on the first line that begins at or after its nominal offset
+static const char* __chunk_start(const char* data, const char* end, size_t offset)
+{
+        if (offset == 0) {
+                return data;
+        }
+        const char* nl = memchr(data + offset - 1, '\n', end - (data + offset - 1));
+        return nl ? nl + 1 : end;
+}
+
+static void __scan_edges_task(int thread_id, int num_threads, void* user_data)
+{
+        struct scan_pack* pack = user_data;
+        size_t size = pack->end - pack->data;
+        const char* begin = __chunk_start(pack->data, pack->end, size*thread_id/num_threads);
+        const char* end = thread_id + 1 == num_threads ?
+                pack->end : __chunk_start(pack->data, pack->end, size*(thread_id + 1)/num_threads);
+        __batch_init(&pack->batches[thread_id]);
+        if (pack->by_token) {
+                pack->has_odd[thread_id] = __scan_edge_tokens(begin, end, pack->id_base, &pack->batches[thread_id],
+                                                              &pack->odd[thread_id]);
+        } else {
+                __scan_edge_lines(begin, end, pack->id_base, &pack->batches[thread_id]);
+                pack->has_odd[thread_id] = false;
+        }
+}
+
+#define c_MinParallelScanBytes          (1 << 20)
+
+// splits the edge section on line boundaries and scans the chunks on all cores, by_token picks
+// __scan_edge_tokens over __scan_edge_lines
+static void __scan_edges_parallel(const char* p, const char* end, int id_base, bool by_token,
+                                  struct edge_batch* batch)
+{
+        int num_threads = parallel_get_num_threads();
+        if (num_threads <= 1 || end - p < c_MinParallelScanBytes) {
+                int odd;
+                if (by_token) {
+                        __scan_edge_tokens(p, end, id_base, batch, &odd);
+                } else {
+                        __scan_edge_lines(p, end, id_base, batch);
+                }
+                return ;
+        }
+        struct scan_pack pack;
+        pack.data       = p;
+        pack.end        = end;
+        pack.id_base    = id_base;
+        pack.by_token   = by_token;
+        pack.batches    = malloc(sizeof(*pack.batches)*num_threads);
+        pack.odd        = malloc(sizeof(*pack.odd)*num_threads);
+        pack.has_odd    = malloc(sizeof(*pack.has_odd)*num_threads);
+        parallel_run(num_threads, __scan_edges_task, &pack);
+        // concatenate the ends in file order, an odd end pairs up with the first end of the next chunk
+        int num_ends = 2*batch->num_edges;
+        int t;
+        for (t = 0; t < num_threads; t ++) {
+                num_ends += 2*pack.batches[t].num_edges + pack.has_odd[t];
+        }
+        __batch_reserve(batch, (num_ends + 1)/2);
+        num_ends = 2*batch->num_edges;
+        for (t = 0; t < num_threads; t ++) {
+                memcpy(&batch->edges[num_ends], pack.batches[t].edges,
+                       sizeof(*batch->edges)*2*pack.batches[t].num_edges);
+                num_ends += 2*pack.batches[t].num_edges;
+                if (pack.has_odd[t]) {
+                        batch->edges[num_ends ++] = pack.odd[t];
+                }
+                __batch_free(&pack.batches[t]);
+        }
+        batch->num_edges = num_ends/2;
+        free(pack.batches);
+        free(pack.odd);
+        free(pack.has_odd);
+}
 
 struct bio_graph* graph_importer_read_txt_file(const char* filename)
 {
-        FILE* f;
-        f = fopen(filename, "r");
-        if (f == nullptr) {
+        struct mapped_file file;
+        if (!__map_file(&file, filename)) {
                 printf("cannot open txt graph file: %s\n", filename);
                 return nullptr;
         }
+        const char* p = file.data;
+        const char* end = file.data + file.size;
 
+        // the vertex count is the first token, the edges follow it on the same line or the next ones
         int num_nodes;
-        if (1 != fscanf(f, "%d", &num_nodes)) {
+        bool ok;
+        while (p < end && __is_space(*p)) p ++;
+        p = __scan_int(p, end, &num_nodes, &ok);
+        if (!ok || num_nodes < 0 || (p < end && !__is_space(*p))) {
                 printf("bad txt graph file: %s\n", filename);
-                fclose(f);
+                __unmap_file(&file);
                 return nullptr;
         }
 
         struct bio_graph* self = bio_graph_create(num_nodes);
+        struct edge_batch batch;
+        __batch_init(&batch);
+        __scan_edges_parallel(p, end, 0, true, &batch);
+        bio_graph_make_edges_undirected(self, batch.edges, batch.num_edges);
+        __batch_free(&batch);
 
-        while (!feof(f)) {
-                int v0, v1;
-                if (2 != fscanf(f, "%d %d", &v0, &v1)) {
+        __unmap_file(&file);
+        bio_graph_freeze(self);
+        return self;
+}
+
+// sax style tokenizer, hands out one complete tag at a time from a buffer that only
+// grows to the size of the longest tag
+#define c_XmlChunkSize          (1 << 16)
+#define c_MaxXmlAttributes      16
+
+struct xml_stream {
+        FILE*           f;
+        char*           buffer;
+        int             size;
+        int             pos;
+        int             capacity;
+        bool            truncated;      // the file ended inside a tag
+};
+
+struct xml_tag {
+        char*           name;           // "/name" for closing tags
+        int             num_attrs;
+        char*           attr_names[c_MaxXmlAttributes];
+        char*           attr_values[c_MaxXmlAttributes];
+};
+
+static void __xml_init(struct xml_stream* self, FILE* f)
+{
+        self->f         = f;
+        self->capacity  = c_XmlChunkSize;
+        self->buffer    = malloc(self->capacity + 1);
+        self->size      = 0;
+        self->pos       = 0;
+        self->truncated = false;
+}
+
+static void __xml_free(struct xml_stream* self)
+{
+        free(self->buffer);
+        memset(self, 0, sizeof(*self));
+}
+
+static bool __xml_fill(struct xml_stream* self)
+{
+        // move the unconsumed tail to the front and read the next chunk behind it
+        memmove(self->buffer, &self->buffer[self->pos], self->size - self->pos);
+        self->size -= self->pos;
+        self->pos = 0;
+        if (self->capacity - self->size < c_XmlChunkSize) {
+                self->capacity *= 2;
+                self->buffer = realloc(self->buffer, self->capacity + 1);
+        }
+        int n = fread(&self->buffer[self->size], 1, self->capacity - self->size, self->f);
+        self->size += n;
+        self->buffer[self->size] = '\0';
+        return n > 0;
+}
+
+// returns the raw text between '<' and '>' with the terminator replaced by '\0', or nullptr at the end of file.
+// truncated tells a file that ends inside a tag from one that ends cleanly
+static char* __xml_next_tag(struct xml_stream* self)
+{
+        // skip character data
+        while (true) {
+                char* lt = memchr(&self->buffer[self->pos], '<', self->size - self->pos);
+                if (lt) {
+                        self->pos = lt - self->buffer;
+                        break;
+                }
+                self->pos = self->size;
+                if (!__xml_fill(self)) {
+                        return nullptr;
+                }
+        }
+        // find the end of the tag, '>' may appear in quoted values and comments
+        int p = self->pos + 1;
+        char quote = 0;
+        while (true) {
+                if (p >= self->size) {
+                        int offset = p - self->pos;
+                        if (!__xml_fill(self)) {
+                                self->truncated = true;
+                                return nullptr;
+                        }
+                        p = self->pos + offset;
                         continue;
                 }
-                bio_graph_make_edge_undirected(self, v0, v1);
+                char c = self->buffer[p];
+                if (quote) {
+                        if (c == quote) quote = 0;
+                } else if (c == '"' || c == '\'') {
+                        if (strncmp(&self->buffer[self->pos], "<!--", 4)) quote = c;
+                } else if (c == '>') {
+                        if (strncmp(&self->buffer[self->pos], "<!--", 4) ||
+                            (p - self->pos >= 6 && !strncmp(&self->buffer[p - 2], "--", 2))) {
+                                break;
+                        }
+                }
+                p ++;
         }
+        char* tag = &self->buffer[self->pos + 1];
+        self->buffer[p] = '\0';
+        self->pos = p + 1;
+        return tag;
+}
 
-        fclose(f);
-        return self;
+static bool __xml_is_space(char c)
+{
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
 }
 
-static const char* strip_prespace(const char* line)
+static void __xml_decode_entities(char* value)
 {
-        while(*line == ' ') line ++;
-        return line;
+        static const char* entities[] = {"&amp;", "&lt;", "&gt;", "&quot;", "&apos;"};
+        static const char chars[] = {'&', '<', '>', '"', '\''};
+        char* out = value;
+        while (*value) {
+                if (*value == '&') {
+                        unsigned i;
+                        for (i = 0; i < sizeof(chars); i ++) {
+                                if (!strncmp(value, entities[i], strlen(entities[i]))) break;
+                        }
+                        if (i < sizeof(chars)) {
+                                *out ++ = chars[i];
+                                value += strlen(entities[i]);
+                                continue;
+                        }
+                }
+                *out ++ = *value ++;
+        }
+        *out = '\0';
 }
 
-static void strip_useless_ending(char* line)
+static bool __xml_parse_tag(char* text, struct xml_tag* tag)
 {
-        int l = strlen(line);
-        if (l == 0) return ;
-        while (true) {
-                char c = line[l - 1];
-                if (c == '\n' || c == '\r' || c == '\t' || c == ' ') {
-                        line[l - 1] = '\0';
-                        l --;
-                } else break;
+        tag->name = text;
+        tag->num_attrs = 0;
+        while (*text && !__xml_is_space(*text) && *text != '/') text ++;
+        if (*text == '/' && text == tag->name) {
+                // closing tag
+                text ++;
+                while (*text && !__xml_is_space(*text)) text ++;
         }
+        if (*text == '\0') return true;
+        bool self_closing = *text == '/';
+        *text ++ = '\0';
+        while (!self_closing) {
+                while (__xml_is_space(*text)) text ++;
+                if (*text == '\0' || *text == '/' || *text == '?') return true;
+                char* attr_name = text;
+                while (*text && *text != '=' && !__xml_is_space(*text)) text ++;
+                char* attr_name_end = text;
+                while (__xml_is_space(*text)) text ++;
+                if (*text != '=') return false;
+                text ++;
+                while (__xml_is_space(*text)) text ++;
+                char quote = *text;
+                if (quote != '"' && quote != '\'') return false;
+                char* value = ++ text;
+                while (*text && *text != quote) text ++;
+                if (*text == '\0') return false;
+                *attr_name_end = '\0';
+                *text ++ = '\0';
+                __xml_decode_entities(value);
+                if (tag->num_attrs < c_MaxXmlAttributes) {
+                        tag->attr_names[tag->num_attrs] = attr_name;
+                        tag->attr_values[tag->num_attrs] = value;
+                        tag->num_attrs ++;
+                }
+        }
+        return true;
 }
 
-static void free_node_dict(char** node_dict, int num_nodes)
+static const char* __xml_get_attr(const struct xml_tag* tag, const char* name)
 {
         int i;
-        for (i = 0; i < num_nodes; i ++) {
-                free(node_dict[i]);
-                node_dict[i] = nullptr;
+        for (i = 0; i < tag->num_attrs; i ++) {
+                if (!strcmp(tag->attr_names[i], name)) {
+                        return tag->attr_values[i];
+                }
         }
-        free(node_dict);
+        return nullptr;
 }
 
 struct bio_graph* graph_importer_read_gexf_file(const char* filename)
@@ -71,188 +475,484 @@ struct bio_graph* graph_importer_read_gexf_file(const char* filename)
                 printf("cannot open gexf graph file: %s\n", filename);
                 return nullptr;
         }
+        struct xml_stream stream;
+        __xml_init(&stream, f);
         // check if it is a xml file
-        char header[c_MaxLineLength];
-        if (!fgets(header, c_MaxLineLength, f)) {
-                printf("bad gexf graph file: %s\n", filename);
-                fclose(f);
-                return nullptr;
-        }
-        if (0 != strncmp("<?xml version=", header, strlen("<?xml version="))) {
+        char* text = __xml_next_tag(&stream);
+        if (text == nullptr || strncmp("?xml", text, strlen("?xml"))) {
                 printf("bad gexf graph file: %s\n", filename);
+                __xml_free(&stream);
                 fclose(f);
                 return nullptr;
         }
-        // on the first pass, scan the number of noes
-        int num_nodes = 0;
-        while (!feof(f)) {
-                char buffer[c_MaxLineLength];
-                if (!fgets(buffer, c_MaxLineLength, f)) {
-                        //continue;
-                }
-                const char* line = strip_prespace(buffer);
-                if (!strncmp("<node id=", line, strlen("<node id="))) {
-                        num_nodes ++;
-                }
-        }
-        struct bio_graph* self = bio_graph_create(num_nodes);
-        // on the second pass, read node id into dictionary
-        int k = 0;
-        char** node_dict = malloc(sizeof(*node_dict)*num_nodes);
-        fseek(f, 0, SEEK_SET);
-        while (!feof(f)) {
-#define c_MaxIdLength           32
-                char buffer[c_MaxLineLength];
-                if (!fgets(buffer, c_MaxLineLength, f)) {
-                        continue;
-                }
-                const char* line = strip_prespace(buffer);
-                if (!strncmp("<node id=", line, strlen("<node id="))) {
-                        // sample line: <node id="Q9LZV6" label="Q9LZV6">
-                        char id_string[c_MaxIdLength] = {0};
-                        char rest_string[c_MaxLineLength];
-                        sscanf(line, "<node id=%s %s", id_string, rest_string);
-                        node_dict[k] = malloc(strlen(id_string) + 1);
-                        memset(node_dict[k], 0, strlen(id_string) + 1);
-                        strncpy(node_dict[k], id_string, strlen(id_string));
-                        k ++;
-                }
-        }
-        // on the third pass, extract edge info and build the graph
-        fseek(f, 0, SEEK_SET);
-        while (!feof(f)) {
-                char buffer[c_MaxLineLength];
-                if (!fgets(buffer, c_MaxLineLength, f)) {
+        // nodes grow the vertex table as they come, edges refer to nodes declared before them
+        struct bio_graph* self = bio_graph_create(0);
+        struct edge_batch batch;
+        __batch_init(&batch);
+        const char* error = nullptr;
+        bool closed = false;
+        while (error == nullptr && (text = __xml_next_tag(&stream))) {
+                struct xml_tag tag;
+                if (*text == '!' || *text == '?') {
                         continue;
                 }
-                const char* line = strip_prespace(buffer);
-                if (!strncmp("<edge id=", line, strlen("<edge id="))) {
-                        // sample line: <edge id="0" source="Q8L765" target="Q94B33" weight="1.1" />
-                        char edge_id_string[c_MaxIdLength] = {0};
-                        char source_id_string[c_MaxIdLength] = {0};
-                        char dest_id_string[c_MaxIdLength] = {0};
-                        char rest_id_string[c_MaxLineLength] = {0};
-                        sscanf(line, "<edge id=%s source=%s target=%s %s",
-                               edge_id_string, source_id_string, dest_id_string, rest_id_string);
-                        // linear search over the dictionary
-                        int source_id = -1, dest_id = -1;
-                        int i;
-                        for (i = 0; i < num_nodes; i ++) {
-                                if (!strcmp(node_dict[i], source_id_string)) {
-                                        source_id = i;
-                                        break;
-                                }
+                if (closed) {
+                        error = "content after </gexf>";
+                } else if (!__xml_parse_tag(text, &tag)) {
+                        error = "malformed tag";
+                } else if (!strcmp("/gexf", tag.name)) {
+                        closed = true;
+                } else if (!strcmp("node", tag.name)) {
+                        // sample tag: <node id="Q9LZV6" label="Q9LZV6">
+                        const char* id = __xml_get_attr(&tag, "id");
+                        if (id == nullptr) {
+                                error = "node without id";
+                        } else if (bio_graph_find_vertex_by_name(self, id) != -1) {
+                                error = "duplicated node id";
+                        } else {
+                                bio_graph_set_vertex_name(self, bio_graph_add_vertex(self), id);
                         }
-                        for (i = 0; i < num_nodes; i ++) {
-                                if (!strcmp(node_dict[i], dest_id_string)) {
-                                        dest_id = i;
-                                        break;
-                                }
+                } else if (!strcmp("edge", tag.name)) {
+                        // sample tag: <edge id="0" source="Q8L765" target="Q94B33" weight="1.1" />
+                        const char* source = __xml_get_attr(&tag, "source");
+                        const char* target = __xml_get_attr(&tag, "target");
+                        const char* weight = __xml_get_attr(&tag, "weight");
+                        int source_id = source ? bio_graph_find_vertex_by_name(self, source) : -1;
+                        int dest_id = target ? bio_graph_find_vertex_by_name(self, target) : -1;
+                        char* weight_end = nullptr;
+                        if (weight) {
+                                // bio_graph is unweighted, the weight is only validated
+                                strtod(weight, &weight_end);
                         }
                         if (source_id == -1 || dest_id == -1) {
-                                printf("bad gexf graph file: %s\n", filename);
-                                fclose(f);
-                                free_node_dict(node_dict, num_nodes);
-                                bio_graph_free(self);
-                                return nullptr;
+                                error = "edge refers to an unknown node";
+                        } else if (weight && (weight_end == weight || *weight_end != '\0')) {
+                                error = "bad edge weight";
+                        } else {
+                                __batch_push(&batch, source_id, dest_id);
                         }
-                        bio_graph_make_edge_undirected(self, source_id, dest_id);
                 }
         }
-        // release resources
-        free_node_dict(node_dict, num_nodes);
+        // a cut off file must not load as the part of the graph that made it
+        if (error == nullptr) {
+                if (ferror(f)) {
+                        error = "read error";
+                } else if (stream.truncated) {
+                        error = "unexpected end of file inside a tag";
+                } else if (!closed) {
+                        error = "missing </gexf>";
+                }
+        }
+        __xml_free(&stream);
         fclose(f);
+        if (error) {
+                printf("bad gexf graph file: %s %s\n", filename, error);
+                __batch_free(&batch);
+                bio_graph_free(self);
+                return nullptr;
+        }
+        bio_graph_make_edges_undirected(self, batch.edges, batch.num_edges);
+        __batch_free(&batch);
+        bio_graph_freeze(self);
         return self;
 }
 
-static bool is_safe_line(const char* line)
+// comment and blank lines do not count as nodes
+static bool is_safe_line(const char* line, const char* line_end)
 {
-        const char* s = line;
-        while(*s != '\n') {
-                if (*s == '#') {
-                        return false;
-                }
-                s ++;
-        }
-        if (s == line) {
+        if (line_end > line && line_end[-1] == '\r') line_end --;
+        if (line == line_end) {
                 return false;
         }
-        return true;
+        return memchr(line, '#', line_end - line) == nullptr;
+}
+
+static bool __is_line(const char* line, const char* line_end, const char* expected)
+{
+        while (line_end > line && (line_end[-1] == '\r' || line_end[-1] == ' ' || line_end[-1] == '\t')) line_end --;
+        return (size_t) (line_end - line) == strlen(expected) && !strncmp(line, expected, line_end - line);
 }
 
 struct bio_graph* graph_importer_read_gw_file(const char* filename)
 {
-        FILE* f;
-        f = fopen(filename, "r");
-        if (f == nullptr) {
+        struct mapped_file file;
+        if (!__map_file(&file, filename)) {
                 printf("cannot open gw graph file: %s\n", filename);
                 return nullptr;
         }
-        char buffer[c_MaxLineLength];
+        const char* p = file.data;
+        const char* end = file.data + file.size;
+        const char* line;
+        const char* line_end;
         // verify header
-        const char* not_empty = fgets(buffer, c_MaxLineLength, f);
-        strip_useless_ending(buffer);
-        if (!not_empty || 0 != strcmp("LEDA.GRAPH", buffer)) {
+        if (!__next_line(&p, end, &line, &line_end) || !__is_line(line, line_end, "LEDA.GRAPH")) {
                 printf("bad LEDA(.gw) graph file: %s invalid header, missing identifier LEDA.GRAPH\n", filename);
-                fclose(f);
+                __unmap_file(&file);
                 return nullptr;
         }
         int i;
         for (i = 0; i < 3; i ++) {
                 // ignore the rest of header section
-                if (!fgets(buffer, c_MaxLineLength, f)) {
+                if (!__next_line(&p, end, &line, &line_end)) {
                         printf("bad LEDA(.gw) graph file: %s invalid header, header is short\n", filename);
-                        fclose(f);
+                        __unmap_file(&file);
                         return nullptr;
                 }
         }
         // node section
         int num_nodes;
-        fgets(buffer, c_MaxLineLength, f), strip_useless_ending(buffer);
-        if (1 != sscanf(buffer, "%d", &num_nodes)) {
-                fclose(f);
+        bool ok = false;
+        if (__next_line(&p, end, &line, &line_end)) {
+                __scan_int(line, line_end, &num_nodes, &ok);
+        }
+        if (!ok || num_nodes < 0) {
+                __unmap_file(&file);
                 printf("bad LEDA(.gw) graph file: %s missing node number\n", filename);
                 return nullptr;
         }
+        struct bio_graph* self = bio_graph_create(num_nodes);
+        int name_capacity = 64;
+        char* name = malloc(name_capacity);
         for (i = 0; i < num_nodes; i ++) {
-                if (!fgets(buffer, c_MaxLineLength, f)) {
-                        fclose(f);
-                        printf("bad LEDA(.gw) graph file: %s not enough nodes as specified; \n", filename);
-                        return nullptr;
-                }
-                if (!is_safe_line(buffer)) i --;
-                if (feof(f)) {
-                        fclose(f);
+                if (!__next_line(&p, end, &line, &line_end) || p == end) {
+                        __unmap_file(&file);
+                        free(name);
+                        bio_graph_free(self);
                         printf("bad LEDA(.gw) graph file: %s not enough nodes as specified\n", filename);
                         return nullptr;
                 }
+                if (!is_safe_line(line, line_end)) {
+                        i --;
+                        continue;
+                }
+                // sample line: |{114785}|, unlabeled and repeated labels leave the vertex unnamed
+                const char* label = line;
+                while (label + 1 < line_end && !(label[0] == '|' && label[1] == '{')) label ++;
+                const char* label_end = line_end;
+                while (label_end - 1 > label && !(label_end[-2] == '}' && label_end[-1] == '|')) label_end --;
+                int l = (label_end - 2) - (label + 2);
+                if (label + 1 < line_end && label_end - 1 > label && l > 0) {
+                        if (l + 1 > name_capacity) {
+                                name_capacity = 2*(l + 1);
+                                name = realloc(name, name_capacity);
+                        }
+                        memcpy(name, label + 2, l);
+                        name[l] = '\0';
+                        bio_graph_set_vertex_name(self, i, name);
+                }
         }
-
-        struct bio_graph* self = bio_graph_create(num_nodes);
+        free(name);
 
         // edge section
         int num_edge;
-        fgets(buffer, c_MaxLineLength, f), strip_useless_ending(buffer);
-        if (1 != sscanf(buffer, "%d", &num_edge)) {
-                fclose(f);
+        ok = false;
+        if (__next_line(&p, end, &line, &line_end)) {
+                __scan_int(line, line_end, &num_edge, &ok);
+        }
+        if (!ok) {
+                __unmap_file(&file);
                 bio_graph_free(self);
                 printf("bad LEDA(.gw) graph file: %s missing edge number\n", filename);
                 return nullptr;
         }
-        while (!feof(f)) {
-                int v0, v1;
-#define c_MaxUnusedLength       32
-                char unused[c_MaxUnusedLength];
-                if (!fgets(buffer, c_MaxLineLength, f) && feof(f)) {
-                        continue;
+        struct edge_batch batch;
+        __batch_init(&batch);
+        // the count is only a hint, an edge line takes at least 4 bytes so a lying header cannot
+        // make the batch outgrow the file
+        __batch_reserve(&batch, MIN(MAX(num_edge, 0), (end - p + 1)/4));
+        __scan_edges_parallel(p, end, 1, false, &batch);
+        bio_graph_make_edges_undirected(self, batch.edges, batch.num_edges);
+        __batch_free(&batch);
+
+        __unmap_file(&file);
+        bio_graph_freeze(self);
+        return self;
+}
+
+struct bgb_layout {
+        bool            swap;
+        int             num_verts;
+        int             num_entries;
+        const int*      row_offsets;
+        const int*      col_ids;
+        const int*      name_offsets;   // nullptr when the file has no name table
+        const char*     name_pool;
+        size_t          name_pool_size;
+};
+
+// checks the header, the file size and the checksum, then locates the arrays in the mapping
+static const char* __bgb_locate(const struct mapped_file* file, struct bgb_layout* layout)
+{
+        struct bgb_header header;
+        layout->swap = false;
+        if (file->size < sizeof(header)) {
+                return "truncated header";
+        }
+        memcpy(&header, file->data, sizeof(header));
+        if (memcmp(header.magic, c_BgbMagic, sizeof(header.magic))) {
+                return "bad magic";
+        }
+        if (header.endian_tag == c_BgbEndianTag) {
+                layout->swap = false;
+        } else if (__builtin_bswap32(header.endian_tag) == c_BgbEndianTag) {
+                layout->swap = true;
+                header.version          = __builtin_bswap32(header.version);
+                header.num_verts        = __builtin_bswap32(header.num_verts);
+                header.num_entries      = __builtin_bswap64(header.num_entries);
+                header.name_pool_size   = __builtin_bswap64(header.name_pool_size);
+                header.checksum         = __builtin_bswap64(header.checksum);
+        } else {
+                return "unknown byte order";
+        }
+        if (header.version != c_BgbVersion) {
+                return "unsupported version";
+        }
+        if (header.num_verts < 0 || header.num_entries > INT_MAX || header.name_pool_size > file->size) {
+                return "bad array sizes";
+        }
+        uint64_t expected = sizeof(header) + sizeof(int)*((uint64_t) header.num_verts + 1 + header.num_entries);
+        if (header.name_pool_size > 0) {
+                expected += sizeof(int)*(uint64_t) header.num_verts + bgb_padded_pool_size(header.name_pool_size);
+        }
+        if (expected != file->size) {
+                return "file size does not match the header";
+        }
+        struct bgb_checksum checksum;
+        bgb_checksum_init(&checksum);
+        bgb_checksum_update(&checksum, (const uint32_t*) (file->data + sizeof(header)),
+                            (file->size - sizeof(header))/sizeof(uint32_t), layout->swap);
+        if (bgb_checksum_get(&checksum) != header.checksum) {
+                return "checksum mismatch";
+        }
+
+        layout->num_verts       = header.num_verts;
+        layout->num_entries     = header.num_entries;
+        layout->row_offsets     = (const int*) (file->data + sizeof(header));
+        layout->col_ids         = layout->row_offsets + layout->num_verts + 1;
+        layout->name_offsets    = nullptr;
+        layout->name_pool       = nullptr;
+        layout->name_pool_size  = header.name_pool_size;
+        if (header.name_pool_size > 0) {
+                layout->name_offsets    = layout->col_ids + layout->num_entries;
+                layout->name_pool       = (const char*) (layout->name_offsets + layout->num_verts);
+        }
+        return nullptr;
+}
+
+static const char* __bgb_check_csr(const int* row_offsets, const int* col_ids, int num_verts, int num_entries)
+{
+        if (row_offsets[0] != 0 || row_offsets[num_verts] != num_entries) {
+                return "bad row offsets";
+        }
+        int i;
+        for (i = 0; i < num_verts; i ++) {
+                if (row_offsets[i] > row_offsets[i + 1]) {
+                        return "bad row offsets";
                 }
-                if (3 != sscanf(buffer, "%d %d %s", &v0, &v1, unused)) {
-                        continue;
+        }
+        for (i = 0; i < num_entries; i ++) {
+                if ((unsigned) col_ids[i] >= (unsigned) num_verts) {
+                        return "vertex id out of range";
                 }
-                strip_useless_ending(buffer);
-                bio_graph_make_edge_undirected(self, v0 - 1, v1 - 1);
         }
+        // the graph takes the rows as they are, so they must hold every edge twice, sorted, without
+        // repetition or self-loops, or the edge count and the rebuilds from the rows go wrong
+        int k;
+        for (i = 0; i < num_verts; i ++) {
+                for (k = row_offsets[i]; k < row_offsets[i + 1]; k ++) {
+                        int j = col_ids[k];
+                        if (j == i) {
+                                return "self-loop";
+                        }
+                        if (k > row_offsets[i] && col_ids[k - 1] >= j) {
+                                return "unsorted or repeated row";
+                        }
+                        // bisect the row of j for the mirror entry
+                        int lo = row_offsets[j], hi = row_offsets[j + 1];
+                        while (lo < hi) {
+                                int mid = lo + (hi - lo)/2;
+                                if (col_ids[mid] < i) lo = mid + 1;
+                                else hi = mid;
+                        }
+                        if (lo == row_offsets[j + 1] || col_ids[lo] != i) {
+                                return "asymmetric rows";
+                        }
+                }
+        }
+        return nullptr;
+}
 
-        fclose(f);
+static int* __bgb_copy_swapped(const int* words, int num_words)
+{
+        int* copy = malloc(sizeof(*copy)*MAX(1, num_words));
+        int i;
+        for (i = 0; i < num_words; i ++) {
+                copy[i] = __builtin_bswap32(words[i]);
+        }
+        return copy;
+}
+
+static void __bgb_release_mapping(void* file_ptr)
+{
+        __unmap_file(file_ptr);
+        free(file_ptr);
+}
+
+struct bio_graph* graph_importer_read_bgb_file(const char* filename)
+{
+        struct mapped_file* file = malloc(sizeof(*file));
+        if (!__map_file(file, filename)) {
+                free(file);
+                printf("cannot open bgb graph file: %s\n", filename);
+                return nullptr;
+        }
+        // the file is used in place unless it was written with the other byte order
+        madvise((void*) file->data, file->size, MADV_WILLNEED);
+        struct bgb_layout layout;
+        const char* error = __bgb_locate(file, &layout);
+        int* row_offsets = nullptr;
+        int* col_ids = nullptr;
+        if (error == nullptr) {
+                if (layout.swap) {
+                        row_offsets = __bgb_copy_swapped(layout.row_offsets, layout.num_verts + 1);
+                        col_ids = __bgb_copy_swapped(layout.col_ids, layout.num_entries);
+                } else {
+                        row_offsets = (int*) layout.row_offsets;
+                        col_ids = (int*) layout.col_ids;
+                }
+                error = __bgb_check_csr(row_offsets, col_ids, layout.num_verts, layout.num_entries);
+        }
+        if (error == nullptr && layout.name_pool != nullptr && layout.name_pool[layout.name_pool_size - 1] != '\0') {
+                error = "unterminated name pool";
+        }
+        if (error != nullptr) {
+                if (layout.swap) {
+                        free(row_offsets);
+                        free(col_ids);
+                }
+                __bgb_release_mapping(file);
+                printf("bad bgb graph file: %s %s\n", filename, error);
+                return nullptr;
+        }
+
+        struct bio_graph* self;
+        if (layout.swap) {
+                self = bio_graph_create_from_csr(layout.num_verts, row_offsets, col_ids, nullptr, nullptr);
+        } else {
+                self = bio_graph_create_from_csr(layout.num_verts, row_offsets, col_ids, __bgb_release_mapping, file);
+        }
+        if (layout.name_offsets != nullptr) {
+                int i;
+                for (i = 0; i < layout.num_verts; i ++) {
+                        int offset = layout.swap ? (int) __builtin_bswap32(layout.name_offsets[i]) : layout.name_offsets[i];
+                        if (offset < -1 || offset >= (int) layout.name_pool_size) {
+                                error = "name offset out of range";
+                                break;
+                        }
+                        if (offset != -1 && !bio_graph_set_vertex_name(self, i, &layout.name_pool[offset])) {
+                                error = "duplicated vertex name";
+                                break;
+                        }
+                }
+        }
+        if (layout.swap) {
+                __bgb_release_mapping(file);
+        }
+        if (error != nullptr) {
+                bio_graph_free(self);
+                printf("bad bgb graph file: %s %s\n", filename, error);
+                return nullptr;
+        }
+        bio_graph_freeze(self);
         return self;
 }
+
+// undoes the escapes of the layout writer in place
+static void __unescape_layout_name(char* s)
+{
+        char* d = s;
+        for (; *s; s ++) {
+                if (s[0] == '\\' && s[1] != '\0') {
+                        switch (s[1]) {
+                        case 't': *d ++ = '\t'; s ++; continue;
+                        case 'n': *d ++ = '\n'; s ++; continue;
+                        case 'r': *d ++ = '\r'; s ++; continue;
+                        case '\\': *d ++ = '\\'; s ++; continue;
+                        }
+                }
+                *d ++ = *s;
+        }
+        *d = '\0';
+}
+
+// reads a layout sidecar written by graph_exporter_write_layout_file. vertices are matched by name,
+// numeric ids match the unnamed vertex of that id. placed tells which vertices received a position
+bool graph_importer_read_layout_file(const struct bio_graph* g, const char* filename,
+                                     float* pos_x, float* pos_y, bool* placed)
+{
+        struct mapped_file file;
+        if (!__map_file(&file, filename)) {
+                printf("cannot open layout file: %s\n", filename);
+                return false;
+        }
+        const char* p = file.data;
+        const char* end = file.data + file.size;
+        const char* line;
+        const char* line_end;
+
+        int num_lines;
+        bool ok = false;
+        if (__next_line(&p, end, &line, &line_end)) {
+                __scan_int(line, line_end, &num_lines, &ok);
+        }
+        if (!ok || num_lines < 0) {
+                printf("bad layout file: %s\n", filename);
+                __unmap_file(&file);
+                return false;
+        }
+
+        int n = bio_graph_get_vertex_num(g);
+        int v;
+        for (v = 0; v < n; v ++) {
+                placed[v] = false;
+        }
+        // the line is copied out so that the name and the coordinates are terminated
+        size_t capacity = 256;
+        char* buffer = malloc(capacity);
+        while (__next_line(&p, end, &line, &line_end)) {
+                size_t len = line_end - line;
+                if (len + 1 > capacity) {
+                        capacity = len + 1;
+                        buffer = realloc(buffer, capacity);
+                }
+                memcpy(buffer, line, len);
+                buffer[len] = '\0';
+                char* y = strrchr(buffer, '\t');
+                if (y == nullptr || y == buffer) {
+                        continue;
+                }
+                *y = '\0';
+                char* x = strrchr(buffer, '\t');
+                if (x == nullptr) {
+                        continue;
+                }
+                *x = '\0';
+                // an id never holds a backslash, so the escapes can be undone before matching it
+                __unescape_layout_name(buffer);
+                v = bio_graph_find_vertex_by_name(g, buffer);
+                if (v == -1) {
+                        int id;
+                        const char* id_end = __scan_int(buffer, x, &id, &ok);
+                        if (!ok || id_end != x || id < 0 || id >= n || bio_graph_get_vertex_name(g, id) != nullptr) {
+                                continue;
+                        }
+                        v = id;
+                }
+                pos_x[v] = strtof(x + 1, nullptr);
+                pos_y[v] = strtof(y + 1, nullptr);
+                placed[v] = true;
+        }
+        free(buffer);
+        __unmap_file(&file);
+        return true;
+}
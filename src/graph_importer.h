@@ -5,6 +5,9 @@
 struct bio_graph* graph_importer_read_txt_file(const char* filename);
 struct bio_graph* graph_importer_read_gexf_file(const char* filename);
 struct bio_graph* graph_importer_read_gw_file(const char* filename);
+struct bio_graph* graph_importer_read_bgb_file(const char* filename);
+bool              graph_importer_read_layout_file(const struct bio_graph* g, const char* filename,
+                                                  float* pos_x, float* pos_y, bool* placed);
 
 
 #endif // GRAPH_IMPORTER_H_INCLUDED
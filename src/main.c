@@ -1,8 +1,11 @@
+#include <sys/stat.h>
 #include "common.h"
 #include "bio_graph.h"
+#include "graph_bgb.h"
 #include "graph_importer.h"
 #include "graph_exporter.h"
 #include "graph_display.h"
+#include "parallel.h"
 
 
 enum OperationType {
@@ -19,6 +22,13 @@ struct config_file {
         char*                   g_graph;
         char*                   h_graph;
         char*                   acc_struct;
+        char*                   theta;
+        bool                    multilevel;
+        char*                   tolerance;
+        char*                   max_steps;
+        char*                   layout_in;
+        char*                   layout_out;
+        char*                   seed;
         char*                   graph_image;
         char*                   graph_width;
         char*                   graph_height;
@@ -38,6 +48,15 @@ static void mayday()
         puts("\t--display");
         puts("\t--align");
         puts("\t--generate-image");
+        puts("\t--accelerate-structure none|grid|FADE|barnes-hut");
+        puts("\t--theta");
+        puts("\t--multilevel");
+        puts("\t--tolerance");
+        puts("\t--max-steps");
+        puts("\t--layout-in");
+        puts("\t--layout-out");
+        puts("\t--seed");
+        puts("\t--threads");
 }
 
 static const char*              __get_file_suffix(const char* filename);
@@ -61,6 +80,8 @@ static struct bio_graph* __read_graph_file(const char* filename)
                         graph = graph_importer_read_gexf_file(filename);
                 } else if (!strcmp("gw", suffix)) {
                         graph = graph_importer_read_gw_file(filename);
+                } else if (!strcmp("bgb", suffix)) {
+                        graph = graph_importer_read_bgb_file(filename);
                 } else {
                         printf("cannot recognize the file format of %s\n", filename);
                         return nullptr;
@@ -92,6 +113,10 @@ static bool __write_graph_file(struct bio_graph* graph, const char* filename)
                         if (!graph_exporter_write_gw_file(graph, filename)) {
                                 return false;
                         }
+                } else if (!strcmp("bgb", suffix)) {
+                        if (!graph_exporter_write_bgb_file(graph, filename)) {
+                                return false;
+                        }
                 } else {
                         printf("cannot recognize the file format of %s\n", filename);
                         return false;
@@ -112,21 +137,415 @@ static const char* __get_file_name(const char* path)
         return path;
 }
 
+// an image wider than the exporter's stream buffer has to come back pixel for pixel
+// a failed check of --test reports the condition and fails the run, unlike assert it survives NDEBUG
+#define TEST_CHECK(cond) \
+        do { \
+                if (!(cond)) { \
+                        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+                        return false; \
+                } \
+        } while (0)
+
+static bool __test_wide_ppm_image()
+{
+        const int width = 30000, height = 3, ps = 4;
+        uint8_t* image = malloc(width*height*ps);
+        int i;
+        for (i = 0; i < width*height*ps; i ++) {
+                image[i] = (uint8_t) (i*7 + i/251);
+        }
+        const char* filename = "./test_result/wide.ppm";
+        TEST_CHECK(graph_exporter_write_ppm_image(image, width, height, ps, filename));
+
+        FILE* f = fopen(filename, "rb");
+        TEST_CHECK(f);
+        int w, h, max_value;
+        int n = fscanf(f, "P6 %d %d %d", &w, &h, &max_value);
+        TEST_CHECK(n == 3 && w == width && h == height && max_value == 255);
+        fgetc(f);
+        uint8_t* pixels = malloc(3*width*height);
+        size_t num_read = fread(pixels, 1, 3*width*height, f);
+        bool complete = num_read == (size_t) 3*width*height && fgetc(f) == EOF;
+        fclose(f);
+        TEST_CHECK(complete);
+        for (i = 0; i < width*height; i ++) {
+                TEST_CHECK(pixels[3*i + 0] == image[i*ps + 2]);
+                TEST_CHECK(pixels[3*i + 1] == image[i*ps + 1]);
+                TEST_CHECK(pixels[3*i + 2] == image[i*ps + 0]);
+        }
+        free(pixels);
+        free(image);
+        return true;
+}
+
+// builds a graph with the given edges and checks which vertices its largest component keeps
+static bool __check_largest_component(int num_verts, const int* edges, int num_edges,
+                                      const int* expected, int num_expected)
+{
+        struct bio_graph* g = bio_graph_create(num_verts);
+        bio_graph_make_edges_undirected(g, edges, num_edges);
+        struct bio_graph* comp = bio_graph_get_largest_connected_component(g);
+        TEST_CHECK(bio_graph_get_vertex_num(comp) == num_expected);
+        int i;
+        for (i = 0; i < num_expected; i ++) {
+                TEST_CHECK(bio_graph_get_parent_id(comp, i) == expected[i]);
+        }
+        bio_graph_free(comp);
+        bio_graph_free(g);
+        return true;
+}
+
+static bool __test_largest_component()
+{
+        // empty graph
+        TEST_CHECK(__check_largest_component(0, nullptr, 0, nullptr, 0));
+        // a tie goes to the component of the smallest vertex id
+        static const int tie_edges[] = {2, 3, 0, 1};
+        static const int tie_expected[] = {0, 1};
+        TEST_CHECK(__check_largest_component(4, tie_edges, 2, tie_expected, 2));
+        // otherwise the larger one wins, wherever it starts
+        static const int edges[] = {0, 1, 2, 3, 3, 4};
+        static const int expected[] = {2, 3, 4};
+        TEST_CHECK(__check_largest_component(5, edges, 3, expected, 3));
+        // isolated vertices are components of one
+        static const int isolated_expected[] = {0};
+        TEST_CHECK(__check_largest_component(3, nullptr, 0, isolated_expected, 1));
+        return true;
+}
+
+static bool __test_layout_names()
+{
+        static const char* names[] = {"tab\tname", "line\nbreak", "back\\slash", "\\t", "plain", nullptr};
+        const int n = sizeof(names)/sizeof(names[0]);
+        struct bio_graph* g = bio_graph_create(n);
+        float pos_x[sizeof(names)/sizeof(names[0])];
+        float pos_y[sizeof(names)/sizeof(names[0])];
+        int v;
+        for (v = 0; v < n; v ++) {
+                if (names[v]) {
+                        bio_graph_set_vertex_name(g, v, names[v]);
+                }
+                pos_x[v] = 0.5f*v;
+                pos_y[v] = -1.25f*v;
+        }
+        const char* filename = "./test_result/names.layout";
+        TEST_CHECK(graph_exporter_write_layout_file(g, pos_x, pos_y, filename));
+        float read_x[sizeof(names)/sizeof(names[0])];
+        float read_y[sizeof(names)/sizeof(names[0])];
+        bool placed[sizeof(names)/sizeof(names[0])];
+        TEST_CHECK(graph_importer_read_layout_file(g, filename, read_x, read_y, placed));
+        for (v = 0; v < n; v ++) {
+                TEST_CHECK(placed[v] && read_x[v] == pos_x[v] && read_y[v] == pos_y[v]);
+        }
+        // gw has no way to store a line break
+        TEST_CHECK(!graph_exporter_write_gw_file(g, "./test_result/names.gw"));
+        bio_graph_free(g);
+        return true;
+}
+
+// unnamed vertices are spelled as their id, which must not come back as another vertex
+static bool __test_unnamed_round_trip()
+{
+        static const int edges[] = {0, 1, 1, 2};
+        struct bio_graph* g = bio_graph_create(3);
+        bio_graph_make_edges_undirected(g, edges, 2);
+        bio_graph_set_vertex_name(g, 0, "5");
+        bio_graph_set_vertex_name(g, 2, "b");
+        static const float pos_x[] = {1.0f, 2.0f, 3.0f};
+        static const float pos_y[] = {-1.0f, -2.0f, -3.0f};
+
+        // vertex 1 is unnamed and written as "1", no other vertex is named so
+        TEST_CHECK(graph_exporter_write_gexf_file(g, "./test_result/unnamed.gexf"));
+        struct bio_graph* h = graph_importer_read_gexf_file("./test_result/unnamed.gexf");
+        TEST_CHECK(h && bio_graph_get_vertex_num(h) == 3 && bio_graph_get_edge_num(h) == 2);
+        TEST_CHECK(bio_graph_find_vertex_by_name(h, "5") == 0 && bio_graph_find_vertex_by_name(h, "1") == 1);
+        bio_graph_free(h);
+        TEST_CHECK(graph_exporter_write_gw_file(g, "./test_result/unnamed.gw"));
+        h = graph_importer_read_gw_file("./test_result/unnamed.gw");
+        TEST_CHECK(h && bio_graph_get_vertex_num(h) == 3 && bio_graph_get_edge_num(h) == 2);
+        bio_graph_free(h);
+        float x[3], y[3];
+        bool placed[3];
+        TEST_CHECK(graph_exporter_write_layout_file(g, pos_x, pos_y, "./test_result/unnamed.layout"));
+        TEST_CHECK(graph_importer_read_layout_file(g, "./test_result/unnamed.layout", x, y, placed));
+        int v;
+        for (v = 0; v < 3; v ++) {
+                TEST_CHECK(placed[v] && x[v] == pos_x[v] && y[v] == pos_y[v]);
+        }
+
+        // once vertex 2 is named "1" the spelling of vertex 1 is taken and every writer refuses
+        struct bio_graph* clash = bio_graph_create(3);
+        bio_graph_make_edges_undirected(clash, edges, 2);
+        bio_graph_set_vertex_name(clash, 2, "1");
+        TEST_CHECK(!graph_exporter_write_gexf_file(clash, "./test_result/clash.gexf"));
+        TEST_CHECK(!graph_exporter_write_gw_file(clash, "./test_result/clash.gw"));
+        TEST_CHECK(!graph_exporter_write_layout_file(clash, pos_x, pos_y, "./test_result/clash.layout"));
+        bio_graph_free(clash);
+        bio_graph_free(g);
+        return true;
+}
+
+// a gexf file cut anywhere before its closing tag must not load
+static bool __test_truncated_gexf()
+{
+        static const int edges[] = {0, 1, 1, 2, 2, 3};
+        struct bio_graph* g = bio_graph_create(4);
+        bio_graph_make_edges_undirected(g, edges, 3);
+        const char* filename = "./test_result/full.gexf";
+        TEST_CHECK(graph_exporter_write_gexf_file(g, filename));
+        bio_graph_free(g);
+
+        FILE* f = fopen(filename, "rb");
+        TEST_CHECK(f);
+        char text[4096];
+        size_t size = fread(text, 1, sizeof(text), f);
+        bool complete = size > 0 && size < sizeof(text) && feof(f);
+        fclose(f);
+        TEST_CHECK(complete);
+        g = graph_importer_read_gexf_file(filename);
+        TEST_CHECK(g && bio_graph_get_vertex_num(g) == 4 && bio_graph_get_edge_num(g) == 3);
+        bio_graph_free(g);
+
+        const char* cut_filename = "./test_result/cut.gexf";
+        const char* last_tag = strstr(text, "</gexf>");
+        TEST_CHECK(last_tag);
+        size_t cut;
+        for (cut = 1; cut <= (size_t) (last_tag - text) + strlen("</gexf"); cut ++) {
+                f = fopen(cut_filename, "wb");
+                TEST_CHECK(f);
+                fwrite(text, 1, cut, f);
+                fclose(f);
+                g = graph_importer_read_gexf_file(cut_filename);
+                TEST_CHECK(g == nullptr);
+        }
+        return true;
+}
+
+static struct bio_graph* __read_text(const char* filename, const char* text, bool gw)
+{
+        FILE* f = fopen(filename, "wb");
+        if (f == nullptr) {
+                return nullptr;
+        }
+        fputs(text, f);
+        fclose(f);
+        return gw ? graph_importer_read_gw_file(filename) : graph_importer_read_txt_file(filename);
+}
+
+static bool __test_edge_scanners()
+{
+        // txt edges may be split over lines and separated by any whitespace
+        struct bio_graph* g = __read_text("./test_result/split.txt", "4 0\n1 1\t2\r\n\n 2\n3 x 0", false);
+        TEST_CHECK(g && bio_graph_get_vertex_num(g) == 4 && bio_graph_get_edge_num(g) == 3);
+        bio_graph_free(g);
+        // a gw header claiming more edges than the file can hold is only a hint
+        g = __read_text("./test_result/lying.gw",
+                        "LEDA.GRAPH\nstring\nint\n-2\n2\n|{a}|\n|{b}|\n2000000000\n1 2 0 |{}|\n", true);
+        TEST_CHECK(g && bio_graph_get_vertex_num(g) == 2 && bio_graph_get_edge_num(g) == 1);
+        bio_graph_free(g);
+        return true;
+}
+
+// writes a bgb file around hand-made rows, the checksum is valid so that only the rows are judged
+static bool __write_raw_bgb(const char* filename, int num_verts, const int* row_offsets, const int* col_ids)
+{
+        struct bgb_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, c_BgbMagic, sizeof(header.magic));
+        header.endian_tag       = c_BgbEndianTag;
+        header.version          = c_BgbVersion;
+        header.num_verts        = num_verts;
+        header.num_entries      = row_offsets[num_verts];
+        struct bgb_checksum checksum;
+        bgb_checksum_init(&checksum);
+        bgb_checksum_update(&checksum, (const uint32_t*) row_offsets, num_verts + 1, false);
+        bgb_checksum_update(&checksum, (const uint32_t*) col_ids, header.num_entries, false);
+        header.checksum = bgb_checksum_get(&checksum);
+        FILE* f = fopen(filename, "wb");
+        if (f == nullptr) {
+                return false;
+        }
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+        ok = ok && fwrite(row_offsets, sizeof(*row_offsets), num_verts + 1, f) == (size_t) num_verts + 1;
+        ok = ok && fwrite(col_ids, sizeof(*col_ids), header.num_entries, f) == header.num_entries;
+        return (fclose(f) == 0) && ok;
+}
+
+// bgb rows are used in place, so the loader must refuse rows that are not a proper undirected graph
+static bool __test_bgb_rows()
+{
+        const char* filename = "./test_result/rows.bgb";
+        // path 0-1-2 stored in full
+        static const int rows[] = {0, 1, 3, 4};
+        static const int cols[] = {1, 0, 2, 1};
+        TEST_CHECK(__write_raw_bgb(filename, 3, rows, cols));
+        struct bio_graph* g = graph_importer_read_bgb_file(filename);
+        TEST_CHECK(g && bio_graph_get_edge_num(g) == 2);
+        bio_graph_free(g);
+        // only the upper half of each edge
+        static const int half_rows[] = {0, 1, 2, 2};
+        static const int half_cols[] = {1, 2};
+        TEST_CHECK(__write_raw_bgb(filename, 3, half_rows, half_cols));
+        TEST_CHECK(graph_importer_read_bgb_file(filename) == nullptr);
+        // a repeated edge
+        static const int rep_rows[] = {0, 2, 4};
+        static const int rep_cols[] = {1, 1, 0, 0};
+        TEST_CHECK(__write_raw_bgb(filename, 2, rep_rows, rep_cols));
+        TEST_CHECK(graph_importer_read_bgb_file(filename) == nullptr);
+        // a self-loop
+        static const int loop_rows[] = {0, 2, 3};
+        static const int loop_cols[] = {0, 1, 0};
+        TEST_CHECK(__write_raw_bgb(filename, 2, loop_rows, loop_cols));
+        TEST_CHECK(graph_importer_read_bgb_file(filename) == nullptr);
+        // an unsorted row
+        static const int unsorted_rows[] = {0, 2, 3, 4};
+        static const int unsorted_cols[] = {2, 1, 0, 0};
+        TEST_CHECK(__write_raw_bgb(filename, 3, unsorted_rows, unsorted_cols));
+        TEST_CHECK(graph_importer_read_bgb_file(filename) == nullptr);
+        return true;
+}
+
+// a frozen graph holds every edge twice, in sorted rows without repetition or self-loops
+static bool __check_csr(const struct bio_graph* g)
+{
+        const int* row_offsets;
+        const int* col_ids;
+        bio_graph_get_csr(g, &row_offsets, &col_ids);
+        int n = bio_graph_get_vertex_num(g);
+        TEST_CHECK(row_offsets[0] == 0 && row_offsets[n] == 2*bio_graph_get_edge_num(g));
+        int v, k;
+        for (v = 0; v < n; v ++) {
+                for (k = row_offsets[v]; k < row_offsets[v + 1]; k ++) {
+                        int w = col_ids[k];
+                        TEST_CHECK(w >= 0 && w < n && w != v);
+                        TEST_CHECK(k == row_offsets[v] || col_ids[k - 1] < w);
+                        // the mirror entry, found by bisecting the sorted row of w
+                        int lo = row_offsets[w], hi = row_offsets[w + 1];
+                        while (lo < hi) {
+                                int mid = (lo + hi)/2;
+                                if (col_ids[mid] < v) lo = mid + 1;
+                                else hi = mid;
+                        }
+                        TEST_CHECK(lo < row_offsets[w + 1] && col_ids[lo] == v);
+                }
+        }
+        return true;
+}
+
+// edges added one at a time only reach the queries once the graph is frozen again
+static bool __test_incremental_build()
+{
+        struct bio_graph* g = bio_graph_create(5);
+        bio_graph_make_edge_undirected(g, 0, 1);
+        bio_graph_make_edge_undirected(g, 1, 0);
+        bio_graph_make_edge_undirected(g, 3, 4);
+        bio_graph_make_edge_undirected(g, 4, 1);
+        bio_graph_freeze(g);
+        TEST_CHECK(bio_graph_get_edge_num(g) == 3);
+        TEST_CHECK(__check_csr(g));
+        TEST_CHECK(bio_graph_count_connected_components(g) == 2);
+        bio_graph_free(g);
+        return true;
+}
+
+// the parallel sort and merge of a large edge batch must give the graph the serial path gives
+static bool __test_parallel_build()
+{
+        const int num_verts = 5000, num_edges = 400000;
+        int* edges = malloc(sizeof(*edges)*2*num_edges);
+        uint32_t x = 12345;
+        int i;
+        for (i = 0; i < 2*num_edges; i ++) {
+                x = x*1664525u + 1013904223u;
+                edges[i] = (x >> 8) % num_verts;
+        }
+        int num_threads = parallel_get_num_threads();
+        parallel_set_num_threads(1);
+        struct bio_graph* serial = bio_graph_create(num_verts);
+        bio_graph_make_edges_undirected(serial, edges, num_edges);
+        parallel_set_num_threads(5);
+        struct bio_graph* parallel = bio_graph_create(num_verts);
+        bio_graph_make_edges_undirected(parallel, edges, num_edges);
+        parallel_set_num_threads(num_threads);
+        free(edges);
+
+        TEST_CHECK(__check_csr(parallel));
+        TEST_CHECK(bio_graph_get_edge_num(serial) == bio_graph_get_edge_num(parallel));
+        const int* serial_rows;
+        const int* serial_cols;
+        const int* parallel_rows;
+        const int* parallel_cols;
+        bio_graph_get_csr(serial, &serial_rows, &serial_cols);
+        bio_graph_get_csr(parallel, &parallel_rows, &parallel_cols);
+        TEST_CHECK(!memcmp(serial_rows, parallel_rows, sizeof(*serial_rows)*(num_verts + 1)));
+        TEST_CHECK(!memcmp(serial_cols, parallel_cols, sizeof(*serial_cols)*serial_rows[num_verts]));
+        bio_graph_free(serial);
+        bio_graph_free(parallel);
+        return true;
+}
+
+// loads a sample graph, checks its adjacency and writes its component and degree statistics
+static bool __test_graph_file(const char* filename)
+{
+        char res_file_name[64];
+        snprintf(res_file_name, sizeof(res_file_name), "./test_result/%s.test", __get_file_name(filename));
+        struct bio_graph* g = __read_graph_file(filename);
+        TEST_CHECK(g);
+        TEST_CHECK(__check_csr(g));
+        FILE* fres = fopen(res_file_name, "w");
+        TEST_CHECK(fres);
+
+        int n_comps;
+        int* comp_sizes;
+        free(bio_graph_find_connected_components(g, &n_comps, &comp_sizes));
+        int largest = 0;
+        int j;
+        for (j = 0; j < n_comps; j ++) {
+                largest = MAX(largest, comp_sizes[j]);
+        }
+        free(comp_sizes);
+        fprintf(fres, "the number of connected components is: %d\n", n_comps);
+        fprintf(fres, "the largest connected component has: %d vertices\n", largest);
+        int n;
+        int* collection = bio_graph_find_deg_distri(g, &n);
+        graph_exporter_write_distri2(collection, n, fres);
+
+        free(collection);
+        bio_graph_free(g);
+        fprintf(fres, "==========result for %s ========\n\n", filename);
+        return fclose(fres) == 0;
+}
+
 // test on the basic data structures
-static void test(struct config_file* cfg)
+static bool test(struct config_file* cfg)
 {
         puts("\ntest is launching...");
+        mkdir("./test_result", 0755);
+
+        bool ok = true;
+        ok = __test_wide_ppm_image() && ok;
+        ok = __test_incremental_build() && ok;
+        ok = __test_parallel_build() && ok;
+        ok = __test_largest_component() && ok;
+        ok = __test_layout_names() && ok;
+        ok = __test_unnamed_round_trip() && ok;
+        ok = __test_truncated_gexf() && ok;
+        ok = __test_edge_scanners() && ok;
+        ok = __test_bgb_rows() && ok;
 
         static const char* tests[] = {
                 "./gexf_graph/athal.gexf",
                 "./gexf_graph/cjejuni.gexf",
                 "./gexf_graph/dmel.gexf",
                 "./gexf_graph/ecoli.gexf",
-                "./gexf_graph/scere05.gexf",
-                "./gexf_graph/scere10.gexf",
-                "./gexf_graph/scere15.gexf",
-                "./gexf_graph/scere20.gexf",
-                "./gexf_graph/scerehc.gexf",
+                "./gexf_graph/yeast05.gexf",
+                "./gexf_graph/yeasthc.gexf",
+                "./gw_graph/scere05.gw",
+                "./gw_graph/scere10.gw",
+                "./gw_graph/scere15.gw",
+                "./gw_graph/scere20.gw",
+                "./gw_graph/scerehc.gw",
                 "./txt_graph/n10.txt",
                 "./txt_graph/n100.txt",
                 "./txt_graph/n1000.txt",
@@ -135,26 +554,11 @@ static void test(struct config_file* cfg)
         };
         unsigned i;
         for (i = 0; i < sizeof(tests)/sizeof(char*); i ++) {
-                char res_file_name[32];
-                sprintf(res_file_name, "./test_result/%s.test", __get_file_name(tests[i]));
-                FILE* fres = fopen(res_file_name, "w");
-                assert(fres);
-
-                struct bio_graph* g = __read_graph_file(tests[i]);
-                assert(g);
-
-                fprintf(fres, "the number of connected components is: %d\n", bio_graph_count_connected_components(g));
-                int n;
-                int* collection = bio_graph_find_deg_distri(g, &n);
-                graph_exporter_write_distri2(collection, n, fres);
-
-                free(collection);
-                bio_graph_free(g);
-                fprintf(fres, "==========result for %s ========\n\n", tests[i]);
-                fclose(fres);
+                ok = __test_graph_file(tests[i]) && ok;
         }
 
-        puts("tests have been run");
+        puts(ok ? "tests have been run" : "tests have failed");
+        return ok;
 }
 
 static void conversion(struct config_file* cfg)
@@ -171,33 +575,100 @@ failed:
         bio_graph_free(graph);
 }
 
+static struct graph_display* __create_display(struct config_file* cfg)
+{
+        struct graph_display* display;
+        if (cfg->acc_struct == nullptr || !strcmp("none", cfg->acc_struct)) {
+                display = graph_display_create(AccelerateMethodNone);
+        } else if (!strcmp("grid", cfg->acc_struct)) {
+                display = graph_display_create(AccelerateMethodGrid);
+        } else if (!strcmp("FADE", cfg->acc_struct)) {
+                display = graph_display_create(AccelerateMethodFADE);
+        } else if (!strcmp("barnes-hut", cfg->acc_struct)) {
+                display = graph_display_create(AccelerateMethodBarnesHut);
+        } else {
+                printf("no such accelerating structure as: %s\n", cfg->acc_struct);
+                return nullptr;
+        }
+        if (cfg->theta) {
+                graph_display_set_theta(display, atof(cfg->theta));
+        }
+        graph_display_set_multilevel(display, cfg->multilevel);
+        if (cfg->tolerance) {
+                graph_display_set_tolerance(display, atof(cfg->tolerance));
+        }
+        if (cfg->seed) {
+                graph_display_set_seed(display, strtoull(cfg->seed, nullptr, 10));
+        }
+        return display;
+}
+
+static bool __load_layout(struct config_file* cfg, struct graph_display* display, struct bio_graph* graph)
+{
+        if (cfg->layout_in == nullptr) {
+                return true;
+        }
+        int n = bio_graph_get_vertex_num(graph);
+        float* pos_x = malloc(sizeof(*pos_x)*MAX(1, n));
+        float* pos_y = malloc(sizeof(*pos_y)*MAX(1, n));
+        bool* placed = malloc(sizeof(*placed)*MAX(1, n));
+        bool ok = graph_importer_read_layout_file(graph, cfg->layout_in, pos_x, pos_y, placed);
+        if (ok) {
+                int i, num_placed = 0;
+                for (i = 0; i < n; i ++) {
+                        num_placed += placed[i];
+                }
+                printf("warm start: %d of %d vertices placed from %s\n", num_placed, n, cfg->layout_in);
+                if (num_placed > 0) {
+                        graph_display_set_initial_layout(display, pos_x, pos_y, placed, n);
+                }
+        }
+        free(pos_x);
+        free(pos_y);
+        free(placed);
+        return ok;
+}
+
+static bool __save_layout(struct config_file* cfg, struct graph_display* display, struct bio_graph* graph)
+{
+        if (cfg->layout_out == nullptr) {
+                return true;
+        }
+        const float* pos_x;
+        const float* pos_y;
+        int n;
+        graph_display_get_layout(display, &pos_x, &pos_y, &n);
+        if (n != bio_graph_get_vertex_num(graph)) {
+                puts("no layout to save");
+                return false;
+        }
+        if (!graph_exporter_write_layout_file(graph, pos_x, pos_y, cfg->layout_out)) {
+                return false;
+        }
+        printf("the layout has been saved to: %s\n", cfg->layout_out);
+        return true;
+}
+
 static void display_graph(struct config_file* cfg)
 {
         puts("displaying the graph...");
 
-        struct graph_display* display;
-        if (cfg->acc_struct) {
-                if (!strcmp("none", cfg->acc_struct)) {
-                        display = graph_display_create(AccelerateMethodNone);
-                } else if (!strcmp("grid", cfg->acc_struct)) {
-                        display = graph_display_create(AccelerateMethodGrid);
-                } else if (!strcmp("FADE", cfg->acc_struct)) {
-                        display = graph_display_create(AccelerateMethodFADE);
-                } else {
-                        printf("no such accelerating structure as: %s\n", cfg->acc_struct);
-                        mayday();
-                        return ;
-                }
-        } else {
-                display = graph_display_create(AccelerateMethodNone);
+        struct graph_display* display = __create_display(cfg);
+        if (display == nullptr) {
+                mayday();
+                return ;
         }
 
         // load in the graph
         struct bio_graph* graph = __read_graph_file(cfg->g_graph);
         if (graph == nullptr) goto failed;
 
+        if (!__load_layout(cfg, display, graph)) goto failed;
+
         graph_display_set_dimension(display, atoi(cfg->graph_width), atoi(cfg->graph_height));
-        graph_display_progressive_draw_to_gtk_screen(display, graph, nullptr, cfg->argc, cfg->argv);
+        graph_display_progressive_draw_to_gtk_screen(display, graph, cfg->max_steps ? atoi(cfg->max_steps) : 0,
+                                                     nullptr, cfg->argc, cfg->argv);
+        __save_layout(cfg, display, graph);
 failed:
         graph_display_free(display);
         bio_graph_free(graph);
@@ -218,37 +689,60 @@ static const char* __get_file_suffix(const char* filename)
         return "";
 }
 
+#define c_NumEnergySamples      10
+
+static void __print_layout_stats(const struct graph_display* display)
+{
+        const struct graph_display_stats* stats = graph_display_get_stats(display);
+        printf("layout: %d steps", stats->num_steps);
+        if (stats->total_steps != stats->num_steps) {
+                printf(" (%d over all levels)", stats->total_steps);
+        }
+        puts(stats->converged ? ", converged" : ", stopped at the step limit");
+        if (stats->num_steps == 0) {
+                return ;
+        }
+        // a few evenly spaced points of the energy curve, the last step included
+        printf("energy:");
+        int i;
+        for (i = 0; i < c_NumEnergySamples; i ++) {
+                int step = (long) (stats->num_steps - 1)*i/(c_NumEnergySamples - 1);
+                if (i > 0 && step == (long) (stats->num_steps - 1)*(i - 1)/(c_NumEnergySamples - 1)) {
+                        continue;
+                }
+                printf(" %d:%g", step + 1, stats->energies[step]);
+        }
+        printf("\n");
+}
+
 static void generate_graph_image(struct config_file* cfg)
 {
         puts("generating graph image...");
-        struct graph_display* display;
-        if (cfg->acc_struct) {
-                if (!strcmp("none", cfg->acc_struct)) {
-                        display = graph_display_create(AccelerateMethodNone);
-                } else if (!strcmp("grid", cfg->acc_struct)) {
-                        display = graph_display_create(AccelerateMethodGrid);
-                } else if (!strcmp("FADE", cfg->acc_struct)) {
-                        display = graph_display_create(AccelerateMethodFADE);
-                } else {
-                        printf("no such accelerating structure as: %s\n", cfg->acc_struct);
-                        mayday();
-                        return ;
-                }
-        } else {
-                display = graph_display_create(AccelerateMethodNone);
+        struct graph_display* display = __create_display(cfg);
+        if (display == nullptr) {
+                mayday();
+                return ;
         }
 
         // load in the graph
         struct bio_graph* graph = __read_graph_file(cfg->g_graph);
         if (graph == nullptr) goto failed;
 
+        if (!__load_layout(cfg, display, graph)) goto failed;
+
         // display it
         graph_display_set_dimension(display, atoi(cfg->graph_width), atoi(cfg->graph_height));
-        graph_display_force_directed(display, graph, 20000);
+        graph_display_force_directed(display, graph, cfg->max_steps ? atoi(cfg->max_steps) : 0);
+        __print_layout_stats(display);
+        __save_layout(cfg, display, graph);
         graph_display_rasterize(display);
         int w, h, s;
         const void* image = graph_display_fetch_memory(display, &w, &h, &s);
-        if (!graph_exporter_write_ppm_image(image, w, h, s, cfg->graph_image)) {
+        if (!strcmp("png", __get_file_suffix(cfg->graph_image))) {
+                if (!graph_exporter_write_png_image(image, w, h, s, cfg->graph_image)) {
+                        goto failed;
+                }
+        } else if (!graph_exporter_write_ppm_image(image, w, h, s, cfg->graph_image)) {
                 goto failed;
         }
         printf("the image has been saved to: %s\n", cfg->graph_image);
@@ -316,6 +810,65 @@ int main(int argc, char* argv[])
                         }
                         cfg.acc_struct = argv[i + 1];
                         i += 1;
+                } else if (!strcmp("--theta", argv[i])) {
+                        if (i + 1 >= argc || !strncmp("-", argv[i + 1], 1)) {
+                                puts("not enough arguments for --theta");
+                                cfg.op_type = OperationMayday;
+                                break;
+                        }
+                        cfg.theta = argv[i + 1];
+                        i += 1;
+                } else if (!strcmp("--multilevel", argv[i])) {
+                        cfg.multilevel = true;
+                } else if (!strcmp("--tolerance", argv[i])) {
+                        if (i + 1 >= argc || !strncmp("-", argv[i + 1], 1)) {
+                                puts("not enough arguments for --tolerance");
+                                cfg.op_type = OperationMayday;
+                                break;
+                        }
+                        cfg.tolerance = argv[i + 1];
+                        i += 1;
+                } else if (!strcmp("--max-steps", argv[i])) {
+                        if (i + 1 >= argc || !strncmp("-", argv[i + 1], 1)) {
+                                puts("not enough arguments for --max-steps");
+                                cfg.op_type = OperationMayday;
+                                break;
+                        }
+                        cfg.max_steps = argv[i + 1];
+                        i += 1;
+                } else if (!strcmp("--layout-in", argv[i])) {
+                        if (i + 1 >= argc || !strncmp("-", argv[i + 1], 1)) {
+                                puts("not enough arguments for --layout-in");
+                                cfg.op_type = OperationMayday;
+                                break;
+                        }
+                        cfg.layout_in = argv[i + 1];
+                        i += 1;
+                } else if (!strcmp("--layout-out", argv[i])) {
+                        if (i + 1 >= argc || !strncmp("-", argv[i + 1], 1)) {
+                                puts("not enough arguments for --layout-out");
+                                cfg.op_type = OperationMayday;
+                                break;
+                        }
+                        cfg.layout_out = argv[i + 1];
+                        i += 1;
+                } else if (!strcmp("--seed", argv[i])) {
+                        if (i + 1 >= argc || !strncmp("-", argv[i + 1], 1)) {
+                                puts("not enough arguments for --seed");
+                                cfg.op_type = OperationMayday;
+                                break;
+                        }
+                        cfg.seed = argv[i + 1];
+                        i += 1;
+                } else if (!strcmp("--threads", argv[i])) {
+                        if (i + 1 >= argc || !strncmp("-", argv[i + 1], 1)) {
+                                puts("not enough arguments for --threads");
+                                cfg.op_type = OperationMayday;
+                                break;
+                        }
+                        // 0 picks one thread per processor
+                        parallel_set_num_threads(atoi(argv[i + 1]));
+                        i += 1;
                 } else if (!strcmp("--help", argv[i]) || !strcmp("-h", argv[i])) {
                         cfg.op_type = OperationMayday;
                         break;
@@ -334,13 +887,16 @@ int main(int argc, char* argv[])
                 }
         }
         // interpret configuration and run
-        clock_t start = clock();
+        // wall time, clock() would add up the time of every worker thread
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int status = 0;
         switch (cfg.op_type) {
         case OperationMayday:
                 mayday(&cfg);
                 break;
         case OperationFunTest:
-                test(&cfg);
+                status = test(&cfg) ? 0 : 1;
                 break;
         case OperationConversion:
                 conversion(&cfg);
@@ -355,8 +911,8 @@ int main(int argc, char* argv[])
                 generate_graph_image(&cfg);
                 break;
         }
-        clock_t end = clock();
-        float t = (end - start)/(float) CLOCKS_PER_SEC;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        float t = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)/1e9f;
         printf("Time used: %f\n", t);
-        return 0;
+        return status;
 }
@@ -0,0 +1,206 @@
+#include <pthread.h>
+#include <unistd.h>
+#include "common.h"
+#include "parallel.h"
+
+
+static int g_num_threads = 0;
+
+int parallel_get_num_threads()
+{
+        if (g_num_threads > 0) {
+                return g_num_threads;
+        }
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        return n > 0 ? (int) n : 1;
+}
+
+void parallel_set_num_threads(int num_threads)
+{
+        // non-positive means one thread per online processor
+        g_num_threads = MAX(0, num_threads);
+}
+
+struct parallel_pack {
+        f_Parallel_Task         task;
+        void*                   user_data;
+        int                     thread_id;
+        int                     num_threads;
+};
+
+static void* __parallel_thread_main(void* data)
+{
+        struct parallel_pack* pack = data;
+        pack->task(pack->thread_id, pack->num_threads, pack->user_data);
+        return nullptr;
+}
+
+void parallel_run(int num_threads, f_Parallel_Task task, void* user_data)
+{
+        if (num_threads <= 1) {
+                task(0, 1, user_data);
+                return ;
+        }
+        pthread_t* threads = malloc(sizeof(*threads)*num_threads);
+        bool* joinable = malloc(sizeof(*joinable)*num_threads);
+        struct parallel_pack* packs = malloc(sizeof(*packs)*num_threads);
+        int i;
+        for (i = 0; i < num_threads; i ++) {
+                packs[i].task           = task;
+                packs[i].user_data      = user_data;
+                packs[i].thread_id      = i;
+                packs[i].num_threads    = num_threads;
+        }
+        // the calling thread takes the first share
+        for (i = 1; i < num_threads; i ++) {
+                joinable[i] = 0 == pthread_create(&threads[i], nullptr, __parallel_thread_main, &packs[i]);
+                if (!joinable[i]) {
+                        // out of threads, run the share on the caller
+                        __parallel_thread_main(&packs[i]);
+                }
+        }
+        __parallel_thread_main(&packs[0]);
+        for (i = 1; i < num_threads; i ++) {
+                if (joinable[i]) {
+                        pthread_join(threads[i], nullptr);
+                }
+        }
+        free(packs);
+        free(joinable);
+        free(threads);
+}
+
+struct parallel_pool {
+        pthread_t*              threads;
+        int                     num_threads;    // including the calling thread
+        int                     num_workers;    // threads that were actually started
+
+        pthread_mutex_t         lock;
+        pthread_cond_t          wake;
+        pthread_cond_t          done;
+        unsigned                generation;     // bumped for every launched task
+        int                     num_busy;
+        bool                    quit;
+
+        f_Parallel_Task         task;
+        void*                   user_data;
+        int                     task_threads;
+};
+
+struct parallel_worker {
+        struct parallel_pool*   pool;
+        int                     thread_id;
+};
+
+static void* __parallel_pool_main(void* data)
+{
+        struct parallel_worker* worker = data;
+        struct parallel_pool* self = worker->pool;
+        int thread_id = worker->thread_id;
+        free(worker);
+
+        unsigned seen = 0;
+        pthread_mutex_lock(&self->lock);
+        while (true) {
+                while (!self->quit && self->generation == seen) {
+                        pthread_cond_wait(&self->wake, &self->lock);
+                }
+                if (self->quit) {
+                        break;
+                }
+                seen = self->generation;
+                f_Parallel_Task task = self->task;
+                void* user_data = self->user_data;
+                int num_threads = self->task_threads;
+                pthread_mutex_unlock(&self->lock);
+
+                if (thread_id < num_threads) {
+                        task(thread_id, num_threads, user_data);
+                }
+
+                pthread_mutex_lock(&self->lock);
+                if (-- self->num_busy == 0) {
+                        pthread_cond_signal(&self->done);
+                }
+        }
+        pthread_mutex_unlock(&self->lock);
+        return nullptr;
+}
+
+struct parallel_pool* parallel_pool_create(int num_threads)
+{
+        struct parallel_pool* self = malloc(sizeof(*self));
+        memset(self, 0, sizeof(*self));
+        self->num_threads = MAX(1, num_threads);
+        self->threads = malloc(sizeof(*self->threads)*self->num_threads);
+        pthread_mutex_init(&self->lock, nullptr);
+        pthread_cond_init(&self->wake, nullptr);
+        pthread_cond_init(&self->done, nullptr);
+        // the calling thread is thread 0
+        int i;
+        for (i = 1; i < self->num_threads; i ++) {
+                struct parallel_worker* worker = malloc(sizeof(*worker));
+                worker->pool = self;
+                worker->thread_id = i;
+                if (0 != pthread_create(&self->threads[i], nullptr, __parallel_pool_main, worker)) {
+                        // out of threads, make do with the ones we have
+                        free(worker);
+                        break;
+                }
+                self->num_workers ++;
+        }
+        self->num_threads = self->num_workers + 1;
+        return self;
+}
+
+void parallel_pool_free(struct parallel_pool* self)
+{
+        if (self == nullptr) {
+                return ;
+        }
+        pthread_mutex_lock(&self->lock);
+        self->quit = true;
+        pthread_cond_broadcast(&self->wake);
+        pthread_mutex_unlock(&self->lock);
+        int i;
+        for (i = 1; i <= self->num_workers; i ++) {
+                pthread_join(self->threads[i], nullptr);
+        }
+        pthread_cond_destroy(&self->done);
+        pthread_cond_destroy(&self->wake);
+        pthread_mutex_destroy(&self->lock);
+        free(self->threads);
+        free(self);
+}
+
+int parallel_pool_get_num_threads(const struct parallel_pool* self)
+{
+        return self->num_threads;
+}
+
+void parallel_pool_run(struct parallel_pool* self, int num_threads, f_Parallel_Task task, void* user_data)
+{
+        num_threads = CLAMP(num_threads, 1, self->num_threads);
+        if (num_threads == 1) {
+                task(0, 1, user_data);
+                return ;
+        }
+        pthread_mutex_lock(&self->lock);
+        self->task              = task;
+        self->user_data         = user_data;
+        self->task_threads      = num_threads;
+        self->num_busy          = self->num_workers;
+        self->generation ++;
+        pthread_cond_broadcast(&self->wake);
+        pthread_mutex_unlock(&self->lock);
+
+        task(0, num_threads, user_data);
+
+        // every worker checks in, also those without a share, so none of them still
+        // looks at the task when the next one is launched
+        pthread_mutex_lock(&self->lock);
+        while (self->num_busy > 0) {
+                pthread_cond_wait(&self->done, &self->lock);
+        }
+        pthread_mutex_unlock(&self->lock);
+}
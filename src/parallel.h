@@ -0,0 +1,18 @@
+#ifndef PARALLEL_H_INCLUDED
+#define PARALLEL_H_INCLUDED
+
+
+typedef void (*f_Parallel_Task) (int thread_id, int num_threads, void* user_data);
+
+int                     parallel_get_num_threads();
+void                    parallel_set_num_threads(int num_threads);
+void                    parallel_run(int num_threads, f_Parallel_Task task, void* user_data);
+
+// persistent workers for tasks that are launched many times, e.g. once per simulation step
+struct parallel_pool*   parallel_pool_create(int num_threads);
+void                    parallel_pool_free(struct parallel_pool* self);
+int                     parallel_pool_get_num_threads(const struct parallel_pool* self);
+void                    parallel_pool_run(struct parallel_pool* self, int num_threads, f_Parallel_Task task, void* user_data);
+
+
+#endif // PARALLEL_H_INCLUDED